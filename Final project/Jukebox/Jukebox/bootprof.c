@@ -0,0 +1,42 @@
+// bootprof.c  per-stage boot timestamps and the diagnostic screen
+
+#include <avr/pgmspace.h>    // PSTR
+#include "bootprof.h"        // Header file
+#include "tick.h"            // tick_now()
+#include "lcd.h"             // boot_show()
+
+static uint16_t stamp[BOOT_STAGES] = {
+	[0 ... BOOT_STAGES - 1] = BOOT_PENDING
+};
+
+void boot_mark(uint8_t stage)
+{
+	if (stamp[stage] == BOOT_PENDING) stamp[stage] = tick_now();
+}
+
+uint16_t boot_ms(uint8_t stage)
+{
+	return stamp[stage];
+}
+
+static void field(const char *label, uint8_t stage, uint8_t width)
+{
+	lcd_puts_P(label);
+	if (stamp[stage] != BOOT_PENDING) { lcd_put_uint(stamp[stage], width); return; }
+	while (--width) lcd_putc(' ');
+	lcd_putc('-');
+}
+
+// In  2 EE  3 L 51
+// Frm 54 MP3  100
+void boot_show(void)
+{
+	lcd_clear();
+	lcd_gotoxy(0,0);
+	field(PSTR("In"),   BOOT_INPUTS, 3);
+	field(PSTR(" EE"),  BOOT_RESTORE, 3);
+	field(PSTR(" L"),   BOOT_LCD, 3);
+	lcd_gotoxy(0,1);
+	field(PSTR("Frm"),  BOOT_FRAME, 3);
+	field(PSTR(" MP3"), BOOT_TRIGGER, 5);
+}
@@ -0,0 +1,23 @@
+#ifndef BOOTPROF_H
+#define BOOTPROF_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Boot profiler: ms since the tick started (first thing in main) at the
+// end of each bring-up stage. Shown by boot_show() on the diagnostic screen.
+enum {
+	BOOT_INPUTS,                    // TWI, knob, buttons, shuffle seed, power
+	BOOT_RESTORE,                   // EEPROM journal read back
+	BOOT_LCD,                       // HD44780 reset sequence done
+	BOOT_FRAME,                     // first song screen on the glass
+	BOOT_TRIGGER,                   // Trigger booted and its status query 'Q' sent
+	BOOT_STAGES
+};
+#define BOOT_PENDING 0xFFFF         // stage not reached yet
+
+void     boot_mark(uint8_t stage);  // first call per stage wins
+uint16_t boot_ms(uint8_t stage);
+void     boot_show(void);           // draws the breakdown into the LCD frame (no flush)
+
+#endif
@@ -0,0 +1,88 @@
+// buttons.c  vertical-counter debounce and press/long/double-click gestures
+
+#include "hal.h"             // button pins
+#include "buttons.h"         // Header file
+#include "evq.h"             // EVT_BUTTON to the main loop
+#include <util/atomic.h>     // the tick may already be running at btn_init()
+
+#define BTN_COUNT 2          // HAL_BTN_SELECT, HAL_BTN_ADMIN
+
+enum { G_IDLE, G_DOWN, G_LONG, G_HELD, G_UP, G_DOUBLE };
+
+typedef struct {
+	uint8_t  st;                 // G_* state
+	uint16_t ms;                 // since the press (down states) or release (G_UP)
+} gesture_t;
+
+static uint8_t   level;              // debounced, 1 = pressed
+static uint8_t   ct0 = 0xFF, ct1 = 0xFF; // 2-bit vertical counter per pin
+static uint8_t   sample_ms = 0;      // ms since the last sample
+static gesture_t g[BTN_COUNT];
+
+void btn_init(void)
+{
+	hal_buttons_init();          // inputs with pull-ups
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		level = hal_buttons();   // held at power-up: only its release is reported
+		ct0 = ct1 = 0xFF;
+		for (uint8_t i = 0; i < BTN_COUNT; i++) g[i].st = (level >> i & 1) ? G_HELD : G_IDLE;
+	}
+}
+
+// All pins at once: a bit toggles after 4 samples that differ from it,
+// any agreeing sample in between resets that pin's count. Returns the toggled bits.
+static uint8_t debounce(uint8_t raw)
+{
+	uint8_t i = level ^ raw;
+	ct0 = ~(ct0 & i);
+	ct1 = ct0 ^ (ct1 & i);
+	i &= ct0 & ct1;
+	level ^= i;
+	return i;
+}
+
+static void post(uint8_t mask, uint8_t gesture)
+{
+	evq_post(EVT_BUTTON, BTN_EVT(mask, gesture));
+}
+
+static void step(gesture_t *b, uint8_t mask, uint8_t edge)
+{
+	uint8_t down = (level & mask) != 0;
+	if (b->ms != 0xFFFF) b->ms++;
+
+	switch (b->st)
+	{
+	case G_IDLE:
+		if (edge && down) { post(mask, BTN_PRESS); b->st = G_DOWN; b->ms = 0; }
+		break;
+	case G_DOWN:                             // short so far
+		if (edge) { post(mask, BTN_RELEASE); b->st = G_UP; b->ms = 0; }
+		else if (b->ms >= BTN_LONG_MS) { post(mask, BTN_LONG); b->st = G_LONG; }
+		break;
+	case G_LONG:
+		if (edge) { post(mask, BTN_RELEASE); b->st = G_IDLE; }
+		else if (b->ms >= BTN_HOLD_MS) { post(mask, BTN_HOLD); b->st = G_HELD; }
+		break;
+	case G_UP:                               // short press released, a second may follow
+		if (edge) { post(mask, BTN_PRESS); post(mask, BTN_DOUBLE); b->st = G_DOUBLE; b->ms = 0; }
+		else if (b->ms >= BTN_DOUBLE_MS) { post(mask, BTN_CLICK); b->st = G_IDLE; }
+		break;
+	case G_HELD:                             // nothing more until it lets go
+	case G_DOUBLE:
+		if (edge) { post(mask, BTN_RELEASE); b->st = G_IDLE; }
+		break;
+	}
+}
+
+void btn_tick(void)
+{
+	uint8_t edges = 0;
+	if (++sample_ms >= BTN_SAMPLE_MS)
+	{
+		sample_ms = 0;
+		edges = debounce(hal_buttons());
+	}
+	for (uint8_t i = 0; i < BTN_COUNT; i++) step(&g[i], 1 << i, edges & (1 << i));
+}
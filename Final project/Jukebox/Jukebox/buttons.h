@@ -0,0 +1,30 @@
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Button debounce and gestures, run from the 1 ms tick ISR. Every
+// BTN_SAMPLE_MS all pins go through one pair of vertical counters (a pin
+// must read the same 4 samples in a row), so a press is reported a fixed
+// 4 * BTN_SAMPLE_MS after the contacts settle. The gesture layer times
+// each debounced button in ms and posts EVT_BUTTON events (evq.h).
+
+enum {
+	BTN_PRESS = 1,                  // debounced down edge
+	BTN_RELEASE,                    // debounced up edge
+	BTN_CLICK,                      // short press, no second one within BTN_DOUBLE_MS
+	BTN_DOUBLE,                     // second press within BTN_DOUBLE_MS (no CLICK then)
+	BTN_LONG,                       // still down after BTN_LONG_MS
+	BTN_HOLD,                       // still down after BTN_HOLD_MS
+};
+
+// EVT_BUTTON data: HAL_BTN_* mask in the high nibble, gesture in the low one
+#define BTN_EVT(mask, g)    ((uint8_t)(((mask) << 4) | (g)))
+#define BTN_EVT_MASK(d)     ((d) >> 4)
+#define BTN_EVT_GESTURE(d)  ((d) & 0x0F)
+
+void btn_init(void);                // pins with pull-ups; buttons held now count as already down
+void btn_tick(void);                // every 1 ms from the timer ISR
+
+#endif
@@ -0,0 +1,196 @@
+// cards.c  EEPROM card table hashed by UID
+
+#include <avr/eeprom.h>      // eeprom_read_byte, eeprom_write_byte
+#include <stdint.h>
+#include <string.h>          // memcmp, memcpy
+#include "cards.h"           // Header file
+#include "tick.h"            // flush batching
+
+#define SLOT_LEN   (MAX_UID_LEN + 1)
+#define META       MAX_UID_LEN      // offset of the meta byte
+#define META_EMPTY 0xFF             // erased EEPROM, probing stops here
+#define META_DEAD  0xFE             // removed card, probing continues past it
+#define META_ADMIN 0x80             // admin cards keep balance 0, so 0x81-0xFF never occur
+#define UIDQ_LEN   2                // new cards whose UID is still being written
+
+extern const char admin_uid[MAX_UID_LEN];   // built-in cards (main.c), enrolled on first boot
+extern const char user_uid [MAX_UID_LEN];
+
+static uint8_t count = 0;
+static uint8_t meta[CARD_SLOTS];                // RAM copy of every meta byte, the one read
+static uint8_t dirty[(CARD_SLOTS + 7) / 8];     // meta bytes not in the EEPROM yet
+static uint8_t ndirty = 0;
+static uint8_t last_dirty = CARD_NONE;          // slot changed last
+static uint8_t next = 0;                        // flush scan position
+static tick_t  due;
+static char    uidq[UIDQ_LEN][MAX_UID_LEN];     // FIFO, entry 0 is being written
+static uint8_t uidq_slot[UIDQ_LEN];
+static uint8_t uidq_n = 0;
+static uint8_t uidq_byte = 0;                   // next byte of entry 0
+
+// All six UID bytes (5 data + checksum) pick the home slot; they are
+// compared in full on a hit, so the hash only has to spread, not identify.
+static uint8_t home_slot(const char *uid)
+{
+	uint16_t h = 0;
+	for (uint8_t i = 0; i < MAX_UID_LEN; i++) h = h * 31 + (uint8_t)uid[i];
+	return ((uint16_t)(uint8_t)((h * 40503U) >> 8) * CARD_SLOTS) >> 8;   // Fibonacci hash, scaled
+}
+
+static uint8_t next_slot(uint8_t s)
+{
+	return (s + 1 == CARD_SLOTS) ? 0 : s + 1;
+}
+
+static uint8_t *slot_addr(uint8_t slot)
+{
+	return (uint8_t *)(uintptr_t)(CARD_ADDR + (uint16_t)slot * SLOT_LEN);
+}
+
+// Balance changes wait in RAM for the batched flush; an add or remove
+// (urgent) goes out with the next cards_task() calls, since the operator
+// has already been told "Card added" / "Card removed"
+static void set_meta(uint8_t slot, uint8_t m, uint8_t urgent)
+{
+	if (meta[slot] == m) return;
+	meta[slot] = m;
+	uint8_t bit = 1 << (slot & 7);
+	if (ndirty && slot != last_dirty) due = tick_now();   // a second card: flush the first now
+	last_dirty = slot;
+	if (dirty[slot >> 3] & bit) return;
+	dirty[slot >> 3] |= bit;
+	if (!ndirty++) due = tick_deadline(CARD_FLUSH_MS);
+	if (urgent) due = tick_now();
+}
+
+// Byte by byte, stops at the first difference (usually the first read)
+static uint8_t slot_is(uint8_t slot, const char *uid)
+{
+	for (uint8_t q = uidq_n; q--; )          // newest first: a slot may be queued twice
+		if (uidq_slot[q] == slot) return !memcmp(uidq[q], uid, MAX_UID_LEN);
+	uint8_t *p = slot_addr(slot);
+	for (uint8_t i = 0; i < MAX_UID_LEN; i++)
+		if (eeprom_read_byte(p + i) != (uint8_t)uid[i]) return 0;
+	return 1;
+}
+
+// One byte of the oldest queued UID, skipped if already there
+static void uid_step(void)
+{
+	uint8_t *p = slot_addr(uidq_slot[0]) + uidq_byte;
+	uint8_t  v = uidq[0][uidq_byte];
+	if (eeprom_read_byte(p) != v) eeprom_write_byte(p, v);
+	if (++uidq_byte < MAX_UID_LEN) return;
+	uidq_byte = 0;
+	uidq_n--;
+	memcpy(uidq[0], uidq[1], MAX_UID_LEN);
+	uidq_slot[0] = uidq_slot[1];
+}
+
+// UID in the background, meta with the next flush (always after the UID):
+// until then the slot reads as free after a reset, never as a half-written
+// card. A removal still waiting for its flush is written first, or the old
+// meta would adopt the new UID.
+static void write_uid(uint8_t slot, const char *uid)
+{
+	uint8_t *p = slot_addr(slot) + META;
+	uint8_t  m = eeprom_read_byte(p);
+	if (m != META_EMPTY && m != META_DEAD) eeprom_write_byte(p, META_DEAD);
+	while (uidq_n == UIDQ_LEN) uid_step();   // enrolment faster than the writer: finish the oldest
+	memcpy(uidq[uidq_n], uid, MAX_UID_LEN);
+	uidq_slot[uidq_n++] = slot;
+}
+
+void cards_init(void)
+{
+	count = 0;
+	for (uint8_t i = 0; i < CARD_SLOTS; i++)
+	{
+		uint8_t m = meta[i] = eeprom_read_byte(slot_addr(i) + META);
+		if (m != META_EMPTY && m != META_DEAD) count++;
+	}
+	if (count) return;
+	cards_add(admin_uid, CARD_ADMIN);   // blank EEPROM: the cards the firmware used to hard-code
+	cards_add(user_uid,  CARD_USER);
+}
+
+uint8_t cards_find(const char *uid)
+{
+	uint8_t s = home_slot(uid);
+	for (uint8_t n = 0; n < CARD_SLOTS; n++, s = next_slot(s))
+	{
+		uint8_t m = meta[s];
+		if (m == META_EMPTY) break;     // never used: the card would have been here
+		if (m != META_DEAD && slot_is(s, uid)) return s;
+	}
+	return CARD_NONE;
+}
+
+uint8_t cards_add(const char *uid, uint8_t role)
+{
+	uint8_t s = cards_find(uid);
+	if (s != CARD_NONE) return s;
+
+	s = home_slot(uid);
+	for (uint8_t n = 0; n < CARD_SLOTS; n++, s = next_slot(s))
+	{
+		uint8_t m = meta[s];
+		if (m != META_EMPTY && m != META_DEAD) continue;
+		write_uid(s, uid);
+		set_meta(s, role == CARD_ADMIN ? META_ADMIN : 0, 1);
+		count++;
+		return s;
+	}
+	return CARD_NONE;
+}
+
+void cards_remove(uint8_t slot)
+{
+	if (!cards_valid(slot)) return;
+	set_meta(slot, META_DEAD, 1);       // the UID bytes stay, unmatched
+	count--;
+}
+
+uint8_t cards_valid(uint8_t slot)
+{
+	if (slot >= CARD_SLOTS) return 0;
+	uint8_t m = meta[slot];
+	return m != META_EMPTY && m != META_DEAD;
+}
+
+uint8_t cards_role(uint8_t slot)
+{
+	return (meta[slot] & META_ADMIN) ? CARD_ADMIN : CARD_USER;
+}
+
+uint8_t cards_balance(uint8_t slot)
+{
+	uint8_t m = meta[slot];
+	return (m & META_ADMIN) ? 0 : m;
+}
+
+void cards_set_balance(uint8_t slot, uint8_t credits)
+{
+	if (!cards_valid(slot) || cards_role(slot) == CARD_ADMIN) return;
+	if (credits > CARD_MAX_CREDITS) credits = CARD_MAX_CREDITS;
+	set_meta(slot, credits, 0);
+}
+
+// Same pacing as persist_task(): one background byte write per call, and
+// only bytes whose value changed are written
+void cards_task(void)
+{
+	if (!eeprom_is_ready()) return;
+	if (uidq_n) { uid_step(); return; }     // new cards first, their meta waits for them
+	if (!ndirty || !tick_expired(due)) return;
+	while (!(dirty[next >> 3] & (1 << (next & 7)))) next = (next + 1 == CARD_SLOTS) ? 0 : next + 1;
+	dirty[next >> 3] &= ~(1 << (next & 7));
+	ndirty--;
+	uint8_t *p = slot_addr(next) + META;
+	if (eeprom_read_byte(p) != meta[next]) eeprom_write_byte(p, meta[next]);
+}
+
+uint8_t cards_count(void)
+{
+	return count;
+}
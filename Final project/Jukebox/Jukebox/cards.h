@@ -0,0 +1,34 @@
+#ifndef CARDS_H
+#define CARDS_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// RFID card table in EEPROM: open addressing with linear probing. A hash
+// of the UID picks the home slot and the stored UID is compared in full,
+// so two tags never share a slot. Each slot is [UID 6 bytes][meta], meta
+// = role:1 | balance:7, 0xFF free (erased), 0xFE removed.
+//
+// Meta bytes live in RAM. Adds and removals reach the EEPROM within a few
+// cards_task() calls; balance changes wait for one batch CARD_FLUSH_MS
+// after the first, one byte per call. The paying card's balance is also
+// in the persist journal, which restore_state() prefers, so a reset
+// inside the window loses nothing.
+
+#define CARD_NONE        0xFF       // "no slot"
+#define CARD_USER        0
+#define CARD_ADMIN       1
+#define CARD_MAX_CREDITS 127        // per-card balance limit (7 bits)
+
+void    cards_init(void);                             // count the table, seed the built-in cards if empty
+uint8_t cards_find(const char *uid);                  // slot, or CARD_NONE if not enrolled
+uint8_t cards_add(const char *uid, uint8_t role);     // slot, or CARD_NONE when the table is full
+void    cards_remove(uint8_t slot);
+uint8_t cards_valid(uint8_t slot);                    // 1 if slot holds an enrolled card
+uint8_t cards_role(uint8_t slot);
+uint8_t cards_balance(uint8_t slot);
+void    cards_set_balance(uint8_t slot, uint8_t credits); // clamped to CARD_MAX_CREDITS
+uint8_t cards_count(void);
+void    cards_task(void);                             // every 10 ms: at most one EEPROM byte per call
+
+#endif
@@ -0,0 +1,54 @@
+// catalog.c lazy reads from the packed PROGMEM track catalog
+
+#include "jukebox_config.h"  // Includes code from jukebox_config.h
+#include <avr/pgmspace.h>    // PROGMEM, pgm_read_*, strncpy_P
+#include "catalog.h"         // Header file
+
+#define CATALOG_IMPL         // pull the flash tables out of the generated header
+#include "catalog_data.h"
+
+// Start of entry idx in catalog_blob: [track][gain][title]\0[artist]\0
+static const char *entry(uint8_t idx)
+{
+	return catalog_blob + pgm_read_word(&catalog_index[idx]);
+}
+
+uint8_t catalog_track(uint8_t idx)
+{
+	return pgm_read_byte(entry(idx));
+}
+
+int8_t catalog_gain(uint8_t idx)
+{
+	return (int8_t)pgm_read_byte(entry(idx) + 1);
+}
+
+void catalog_title(uint8_t idx, char *buf)
+{
+	strncpy_P(buf, entry(idx) + 2, CATALOG_NAME_MAX);
+	buf[CATALOG_NAME_MAX] = '\0';
+}
+
+void catalog_artist(uint8_t idx, char *buf)
+{
+	const char *p = entry(idx) + 2;
+	p += strlen_P(p) + 1;                     // skip the title
+	strncpy_P(buf, p, CATALOG_NAME_MAX);
+	buf[CATALOG_NAME_MAX] = '\0';
+}
+
+// Catalog index of an SD track number, -1 if no entry plays it.
+// mkcatalog.py sorts the entries by track, so this is a binary search
+// (8 probes for 255 tracks; also called from the MP3 TX ISR).
+int16_t catalog_find(uint8_t track)
+{
+	uint8_t lo = 0, hi = TOTAL_SONGS;        // [lo, hi)
+	while (lo < hi)
+	{
+		uint8_t mid = lo + (hi - lo) / 2;
+		uint8_t t   = catalog_track(mid);
+		if (t == track) return mid;
+		if (t < track) lo = mid + 1; else hi = mid;
+	}
+	return -1;
+}
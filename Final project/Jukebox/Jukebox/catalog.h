@@ -0,0 +1,17 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Track catalog kept in flash (see tools/mkcatalog.py). Entries are read
+// on demand, so nothing but the caller's buffer lives in SRAM.
+#define CATALOG_NAME_MAX 16                       // LCD width, longest title/artist
+
+uint8_t catalog_track(uint8_t idx);               // MP3 Trigger track number (1-255)
+int8_t  catalog_gain(uint8_t idx);                // volume steps added while it plays (<0 = quieter)
+void    catalog_title(uint8_t idx, char *buf);    // buf holds CATALOG_NAME_MAX+1 chars
+void    catalog_artist(uint8_t idx, char *buf);   // buf holds CATALOG_NAME_MAX+1 chars
+int16_t catalog_find(uint8_t track);              // index of an SD track, -1 if none
+
+#endif
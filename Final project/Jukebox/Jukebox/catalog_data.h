@@ -0,0 +1,33 @@
+// catalog_data.h  -  generated by tools/mkcatalog.py, do not edit
+// Included by jukebox_config.h for the count; catalog.c defines
+// CATALOG_IMPL to get the flash tables.
+
+#ifndef CATALOG_DATA_H
+#define CATALOG_DATA_H
+
+#define CATALOG_COUNT 10
+
+#endif
+
+#if defined(CATALOG_IMPL) && !defined(CATALOG_TABLES)
+#define CATALOG_TABLES
+
+static const uint16_t catalog_index[CATALOG_COUNT] PROGMEM = {
+    0, 16, 32, 51, 68, 86, 110, 124,
+    148, 170,
+};
+
+// [track][gain][title]\0[artist]\0 per entry, sorted by track
+static const char catalog_blob[] PROGMEM =
+    "\x01" "\x00" "Go Robot" "\0" "RHCP" "\0"
+    "\x02" "\x00" "Migra" "\0" "Santana" "\0"
+    "\x03" "\x00" "Expresso" "\0" "Sabrina" "\0"
+    "\x04" "\xFC" "Sticky" "\0" "TylerTC" "\0"
+    "\x05" "\x00" "Judas" "\0" "Lady Gaga" "\0"
+    "\x06" "\x04" "Let It Be" "\0" "The Beatles" "\0"
+    "\x07" "\x00" "Africa" "\0" "Toto" "\0"
+    "\x08" "\x00" "Sweet Child" "\0" "Guns N' R" "\0"
+    "\x09" "\xF8" "Thunderstruck" "\0" "AC/DC" "\0"
+    "\x0A" "\x00" "Yesterday" "\0" "The Beatles" "\0";
+
+#endif // CATALOG_IMPL
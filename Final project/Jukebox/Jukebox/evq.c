@@ -0,0 +1,31 @@
+// evq.c  single-producer/single-consumer event ring, ISRs to the main loop
+
+#include "evq.h"             // Header file
+
+volatile evt_t   evq_ring[EVQ_LEN];
+volatile uint8_t evq_head = 0;
+volatile uint8_t evq_tail = 0;
+volatile uint8_t evq_lost = 0;
+
+// Takes one batch: everything posted up to the head read here, at most max.
+// The slots go back to the producer with a single store of the tail.
+uint8_t evq_drain(evt_t *buf, uint8_t max)
+{
+	uint8_t t = evq_tail;
+	uint8_t h = evq_head;
+	uint8_t n = 0;
+	while (t != h && n < max)
+	{
+		buf[n].type = evq_ring[t].type;
+		buf[n].data = evq_ring[t].data;
+		n++;
+		t = (t + 1) & EVQ_MASK;
+	}
+	evq_tail = t;
+	return n;
+}
+
+uint8_t evq_dropped(void)
+{
+	return evq_lost;
+}
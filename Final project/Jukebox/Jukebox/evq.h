@@ -0,0 +1,52 @@
+#ifndef EVQ_H
+#define EVQ_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Event ring from the ISRs to the main loop. AVR interrupts never nest, so
+// all ISRs together are one producer; the main loop is the only consumer.
+// Head and tail are single bytes, each written by one side only, so neither
+// side masks interrupts. Main-loop code that posts (mp3Service() starting the
+// queue) does it inside an ATOMIC_BLOCK, which puts it on the producer side.
+
+enum {
+	EVT_TICK,                       // at least one 1 ms tick since the last drain
+	EVT_ENC,                        // knob detent, data = signed step (int8_t)
+	EVT_BUTTON,                     // button gesture, data = HAL_BTN_* mask << 4 | BTN_* gesture,
+	                                // split with BTN_EVT_MASK() / BTN_EVT_GESTURE() (buttons.h)
+	EVT_MP3,                        // Trigger reply, data = MP3_EVT_* bits of that reply
+};
+
+typedef struct {
+	uint8_t type;
+	uint8_t data;
+} evt_t;
+
+#define EVQ_MASK (EVQ_LEN - 1)
+
+extern volatile evt_t   evq_ring[EVQ_LEN];
+extern volatile uint8_t evq_head;  // next free slot, producer only
+extern volatile uint8_t evq_tail;  // oldest event, consumer only
+extern volatile uint8_t evq_lost;  // events dropped on a full ring (saturates)
+
+// Producer side, interrupts off. 0 = ring full, event dropped and counted.
+static inline uint8_t evq_post(uint8_t type, uint8_t data)
+{
+	uint8_t h = evq_head;
+	uint8_t n = (h + 1) & EVQ_MASK;
+	if (n == evq_tail)
+	{
+		if (evq_lost != 0xFF) evq_lost++;
+		return 0;
+	}
+	evq_ring[h].type = type;
+	evq_ring[h].data = data;
+	evq_head = n;                   // publish after the payload
+	return 1;
+}
+
+uint8_t evq_drain(evt_t *buf, uint8_t max);   // main: copies up to max events, returns how many
+uint8_t evq_dropped(void);
+
+#endif
@@ -0,0 +1,242 @@
+// hal.h  -  thin hardware layer under the jukebox drivers
+//
+// Every register the drivers touch goes through one of these calls. On the
+// ATmega328P they are static inline and compile to the same sbi/cbi/in/out
+// the drivers used before. Building with HAL_HOST swaps in the simulated
+// peripherals from host/ (fake LCD, MP3 Trigger, RFID reader, knob, buttons)
+// so the real application logic can run on a workstation.
+//
+// The drivers next to this file (lcd, twi, uart) are shared: Lab5 and
+// FinalProj_tester link them from here. Pins are fixed at compile time,
+// so with a constant argument every pin access is a single sbi/cbi/in/out.
+// A firmware wired differently defines the HAL_* pin macros in its
+// project symbols before including this file.
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+#ifdef HAL_HOST
+#include "hal_host.h"        // host/hal_host.h, same names backed by the simulator
+#else
+
+#include <avr/io.h>          // AVR I/O register definitions
+#include <avr/interrupt.h>   // sei()
+#include <avr/wdt.h>         // watchdog control
+#include <avr/sleep.h>       // idle sleep between interrupts
+
+// ---------- Pin map (see the wiring table at the end of main.c)
+#ifndef HAL_LCD_RS
+#define HAL_LCD_DATA_PORT PORTC   // PC0-PC3 = D4-D7 (4-bit mode)
+#define HAL_LCD_DATA_DDR  DDRC
+#define HAL_LCD_CTRL_PORT PORTB   // PB0 = RS, PB1 = E
+#define HAL_LCD_CTRL_DDR  DDRB
+#define HAL_LCD_RS        PB0
+#define HAL_LCD_E         PB1
+#endif
+#ifndef HAL_BUSY_PIN
+#define HAL_BUSY_PIN      PB2     // MP3 Trigger BUSY, low while playing
+#endif
+#ifndef HAL_ENC_A
+#define HAL_ENC_A         PD2     // RPG channel A
+#define HAL_ENC_B         PD3     // RPG channel B
+#endif
+#ifndef HAL_BTN_SELECT_PIN
+#define HAL_BTN_SELECT_PIN PD4    // play/select button
+#define HAL_BTN_ADMIN_PIN  PD5    // admin stop/shuffle button
+#endif
+#ifndef HAL_AMP_STBY_PIN
+#define HAL_AMP_STBY_PIN  PD6     // STA540 STBY, low = amplifier in standby
+#endif
+#define HAL_TWI_SDA       PC4     // fixed by the TWI unit
+#define HAL_TWI_SCL       PC5
+
+// hal_buttons() bits, 1 = pressed
+#define HAL_BTN_SELECT 0x01
+#define HAL_BTN_ADMIN  0x02
+
+// ---------- System
+static inline void hal_wdt_off(void) { MCUSR = 0; wdt_disable(); }
+static inline void hal_wdt_on(void)  { wdt_enable(WDTO_500MS); }   // reset if the loop hangs
+static inline void hal_wdt_kick(void) { wdt_reset(); }
+static inline void hal_irq_on(void)  { sei(); }
+
+// End of one main-loop pass: IDLE sleep until the next interrupt (1 ms tick,
+// knob, UART, TWI). Timers and the UART keep running, and the wake-up is
+// a few cycles, so nothing the ISRs flagged waits more than one tick.
+static inline void hal_idle(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sleep_cpu();
+	sleep_disable();
+}
+
+// Clocks off for the blocks the jukebox never uses: SPI, Timer1, analog comparator
+// (hal_stamp_init() turns Timer1 back on for the latency instrumentation)
+static inline void hal_power_init(void)
+{
+	ACSR = (1 << ACD);
+	PRR |= (1 << PRSPI) | (1 << PRTIM1);
+}
+
+// ---------- Timer0: 1 ms tick (CTC, 16MHz/64/250)
+static inline void hal_tick_init(uint8_t top)
+{
+	TCCR0A = (1 << WGM01);                   // CTC, TOP = OCR0A
+	OCR0A  = top;
+	TCNT0  = 0;
+	TIMSK0 = (1 << OCIE0A);                  // compare-match A interrupt
+	TCCR0B = (1 << CS01) | (1 << CS00);      // prescaler 64 -> 4 us per count
+}
+static inline uint8_t hal_tick_count(void)   { return TCNT0; }
+static inline uint8_t hal_tick_pending(void) { return TIFR0 & (1 << OCF0A); }
+
+// ---------- Timer1: free-running stamp for the latency instrumentation (instr.c)
+// Normal mode, clk/8: 0.5 us per count, wraps every 32.8 ms. TCNT1 is read
+// through the shared TEMP register, so outside an ISR read it with interrupts off.
+static inline void hal_stamp_init(void)
+{
+	PRR   &= ~(1 << PRTIM1);
+	TCCR1A = 0;
+	TCCR1B = (1 << CS11);
+}
+static inline uint16_t hal_stamp(void) { return TCNT1; }
+
+// ---------- Timer2: 1 ms one-shot gap for the MP3 UART
+static inline void hal_gap_init(void)
+{
+	TCCR2A = (1 << WGM21);       // CTC mode
+	TCCR2B = 0;                  // stopped until a gap is needed
+	OCR2A  = 249;                // 250 counts = 1 ms
+	TIMSK2 = (1 << OCIE2A);      // compare-match interrupt
+}
+static inline void hal_gap_start(void) { TCNT2 = 0; TCCR2B = (1 << CS22); } // prescaler 64
+static inline void hal_gap_stop(void)  { TCCR2B = 0; }
+
+// ---------- USART0 (MP3 Trigger link, Lab5 console)
+static inline void hal_uart_init(uint16_t ubrr, uint8_t rx_irq)
+{
+	UBRR0H = ubrr >> 8;                                   // set high byte
+	UBRR0L = ubrr & 0xFF;                                 // set low byte
+	UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (rx_irq ? (1 << RXCIE0) : 0);
+	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);               // Set 8-bit data format
+}
+static inline uint8_t hal_uart_tx_ready(void) { return UCSR0A & (1 << UDRE0); } // UDR0 empty
+static inline uint8_t hal_uart_rx_ready(void) { return UCSR0A & (1 << RXC0); }  // byte waiting
+static inline uint8_t hal_uart_tx_done(void)              // last stop bit out, clears TXC0
+{
+	if (!(UCSR0A & (1 << TXC0))) return 0;
+	UCSR0A |= (1 << TXC0);
+	return 1;
+}
+static inline void    hal_uart_tx_irq_on(void)  { UCSR0B |=  (1 << UDRIE0); }
+static inline void    hal_uart_tx_irq_off(void) { UCSR0B &= ~(1 << UDRIE0); }
+static inline void    hal_uart_put(uint8_t c)   { UDR0 = c; }
+static inline uint8_t hal_uart_get(void)        { return UDR0; }
+
+// ---------- MP3 Trigger BUSY line
+static inline void hal_busy_init(uint8_t irq)
+{
+	DDRB  &= ~(1 << HAL_BUSY_PIN);           // input
+	PORTB |=  (1 << HAL_BUSY_PIN);           // with pull-up
+	if (irq)
+	{
+		PCMSK0 |= (1 << PCINT2);         // pin-change interrupt on PB2
+		PCICR  |= (1 << PCIE0);
+	}
+}
+static inline uint8_t hal_busy_idle(void) { return PINB & (1 << HAL_BUSY_PIN); }
+
+// ---------- HD44780 bus
+static inline void hal_lcd_init_pins(void)
+{
+	HAL_LCD_DATA_DDR |= 0x0F;                                  // D4-D7 outputs
+	HAL_LCD_CTRL_DDR |= (1 << HAL_LCD_RS) | (1 << HAL_LCD_E);  // RS, E outputs
+}
+static inline void hal_lcd_data(uint8_t n) { HAL_LCD_DATA_PORT = (HAL_LCD_DATA_PORT & 0xF0) | (n & 0x0F); }
+static inline void hal_lcd_rs(uint8_t on)
+{
+	if (on) HAL_LCD_CTRL_PORT |= (1 << HAL_LCD_RS); else HAL_LCD_CTRL_PORT &= ~(1 << HAL_LCD_RS);
+}
+static inline void hal_lcd_e(uint8_t on)
+{
+	if (on) HAL_LCD_CTRL_PORT |= (1 << HAL_LCD_E); else HAL_LCD_CTRL_PORT &= ~(1 << HAL_LCD_E);
+}
+
+// ---------- TWI
+static inline void    hal_twi_init(uint8_t twbr) { TWSR = 0; TWBR = twbr; TWCR = (1 << TWEN); }
+static inline void    hal_twi_ctrl(uint8_t v)    { TWCR = v; }
+static inline uint8_t hal_twi_status(void)       { return TWSR & 0xF8; }
+static inline void    hal_twi_put(uint8_t d)     { TWDR = d; }
+static inline uint8_t hal_twi_get(void)          { return TWDR; }
+
+// Bus recovery: TWI unit off, SDA/SCL driven open-drain by hand
+static inline void hal_twi_release(void)
+{
+	TWCR = 0;                                              // TWI unit lets go of the pins
+	DDRC  &= ~((1 << HAL_TWI_SDA) | (1 << HAL_TWI_SCL));   // float high on the bus pull-ups
+	PORTC &= ~((1 << HAL_TWI_SDA) | (1 << HAL_TWI_SCL));   // DDR bit set = drive low
+}
+static inline void hal_twi_scl(uint8_t high)
+{
+	if (high) DDRC &= ~(1 << HAL_TWI_SCL); else DDRC |= (1 << HAL_TWI_SCL);
+}
+static inline void hal_twi_sda(uint8_t high)
+{
+	if (high) DDRC &= ~(1 << HAL_TWI_SDA); else DDRC |= (1 << HAL_TWI_SDA);
+}
+static inline uint8_t hal_twi_sda_high(void) { return PINC & (1 << HAL_TWI_SDA); }
+
+// ---------- ADC as a noise source (shuffle seed only, off the rest of the time)
+static inline void hal_noise_init(void)
+{
+	PRR   &= ~(1 << PRADC);
+	ADMUX  = (1 << REFS1) | (1 << REFS0) | (1 << MUX3);   // temperature sensor, 1.1 V ref
+	ADCSRA = (1 << ADEN) | (1 << ADPS1);                  // clk/4: far past spec, noisy LSBs
+}
+static inline uint16_t hal_noise_sample(void)
+{
+	ADCSRA |= (1 << ADSC);
+	while (ADCSRA & (1 << ADSC));
+	return ADC;
+}
+static inline void hal_noise_off(void) { ADCSRA = 0; PRR |= (1 << PRADC); }
+
+// ---------- STA540 amplifier standby
+static inline void hal_amp_init(void) { DDRD |= (1 << HAL_AMP_STBY_PIN); PORTD &= ~(1 << HAL_AMP_STBY_PIN); }
+static inline void hal_amp(uint8_t on)
+{
+	if (on) PORTD |= (1 << HAL_AMP_STBY_PIN); else PORTD &= ~(1 << HAL_AMP_STBY_PIN);
+}
+
+// ---------- Rotary encoder (PCINT2 on both channels)
+static inline void hal_encoder_init(void)
+{
+	DDRD  &= ~((1 << HAL_ENC_A) | (1 << HAL_ENC_B));   // inputs
+	PORTD |=   (1 << HAL_ENC_A) | (1 << HAL_ENC_B);    // pull-ups
+	PCMSK2 |= (1 << PCINT18) | (1 << PCINT19);         // pin-change on A and B
+	PCICR  |= (1 << PCIE2);                            // PORTD pin-change interrupt
+}
+static inline uint8_t hal_encoder_ab(void)               // (A << 1) | B
+{
+	uint8_t p = PIND;
+	return ((p >> (HAL_ENC_A - 1)) & 0x02) | ((p >> HAL_ENC_B) & 0x01);
+}
+
+// ---------- Buttons (active low with pull-ups)
+static inline void hal_buttons_init(void)
+{
+	DDRD  &= ~((1 << HAL_BTN_SELECT_PIN) | (1 << HAL_BTN_ADMIN_PIN));  // inputs
+	PORTD |=   (1 << HAL_BTN_SELECT_PIN) | (1 << HAL_BTN_ADMIN_PIN);   // pull-ups
+}
+static inline uint8_t hal_buttons(void)
+{
+	uint8_t p = ~PIND;
+	return ((p >> HAL_BTN_SELECT_PIN) & 1) | (((p >> HAL_BTN_ADMIN_PIN) & 1) << 1);
+}
+
+#endif // HAL_HOST
+
+#endif
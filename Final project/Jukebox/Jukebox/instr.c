@@ -0,0 +1,120 @@
+// instr.c  main-loop and ISR latency statistics and their admin pages
+
+#include <string.h>          // memset
+#include <avr/pgmspace.h>    // PSTR
+#include <util/atomic.h>     // ATOMIC_BLOCK for the TCNT1 read and the copy
+#include "instr.h"           // Header file
+#include "tick.h"            // tick_now()
+#include "sched.h"           // worst task run, overruns
+#include "lcd.h"             // instr_show()
+
+instrStats_t instr_stats;
+
+static uint16_t last_stamp;      // wake-up of the current pass
+static uint16_t last_ms;
+static uint8_t  started = 0;     // first pass has no period yet
+
+void instr_init(void)
+{
+	hal_stamp_init();
+	instr_reset();
+}
+
+void instr_reset(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		memset(&instr_stats, 0, sizeof instr_stats);
+		instr_stats.loop_min = 0xFFFF;
+	}
+	started = 0;
+}
+
+void instr_loop(void)
+{
+	uint16_t now;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = hal_stamp();
+	}
+	uint16_t ms = (uint16_t)tick_now();
+	uint16_t d  = now - last_stamp;
+	if ((uint16_t)(ms - last_ms) >= 32) d = 0xFFFF;   // Timer1 wrapped at least once
+	last_stamp = now;
+	last_ms    = ms;
+	if (!started) { started = 1; return; }
+
+	instrStats_t *s = &instr_stats;
+	if (d < s->loop_min) s->loop_min = d;
+	if (d > s->loop_max) s->loop_max = d;
+	s->loop_avg8 += (d > 0x1FFF ? 0x1FFF : d) - (s->loop_avg8 >> 3);  // x8 must fit 16 bits
+	s->loops++;
+}
+
+void instr_loop_end(void)
+{
+	uint16_t now;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = hal_stamp();
+	}
+	if (!started) return;
+	uint16_t d = now - last_stamp;
+	if ((uint16_t)((uint16_t)tick_now() - last_ms) >= 32) d = 0xFFFF;
+
+	instrStats_t *s = &instr_stats;
+	if (d > s->busy_max) s->busy_max = d;
+	s->busy_avg8 += (d > 0x1FFF ? 0x1FFF : d) - (s->busy_avg8 >> 3);
+}
+
+void instr_get(instrStats_t *s)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*s = instr_stats;
+	}
+}
+
+static void field(const char *label, uint32_t us, uint8_t width)
+{
+	lcd_puts_P(label);
+	lcd_put_uint(us > 9999 ? 9999 : us, width);
+}
+
+// Bsy  12 Max   340    Tck  12 Enc   4     Gap   2 Twi   9
+// Per1003 Off    24    Rx    6 Tx    3     Tsk 1850 Ovr   0
+// Bsy is the mean work of a pass, Max the longest; Per the longest
+// period, wake to wake (about one tick, IDLE sleep included)
+void instr_show(uint8_t page)
+{
+	instrStats_t s;
+	instr_get(&s);
+
+	lcd_clear();
+	lcd_gotoxy(0,0);
+	if (page == 0)
+	{
+		field(PSTR("Bsy"),  INSTR_US(s.busy_avg8 >> 3), 4);
+		field(PSTR(" Max"), INSTR_US(s.busy_max), 5);
+		lcd_gotoxy(0,1);
+		field(PSTR("Per"),  INSTR_US(s.loop_max), 4);
+		field(PSTR(" Off"), INSTR_US(s.irq_off_max), 5);
+	}
+	else if (page == 1)
+	{
+		field(PSTR("Tck"),  INSTR_US(s.isr_max[INSTR_TICK]), 4);
+		field(PSTR(" Enc"), INSTR_US(s.isr_max[INSTR_ENC]), 4);
+		lcd_gotoxy(0,1);
+		field(PSTR("Rx "),  INSTR_US(s.isr_max[INSTR_RX]), 4);
+		field(PSTR(" Tx "), INSTR_US(s.isr_max[INSTR_TX]), 4);
+	}
+	else
+	{
+		field(PSTR("Gap"),  INSTR_US(s.isr_max[INSTR_GAP]), 4);
+		field(PSTR(" Twi"), INSTR_US(s.isr_max[INSTR_TWI]), 4);
+		lcd_gotoxy(0,1);
+		field(PSTR("Tsk"),  sched_worst_all_us(), 5);   // longest task run, sched.c (4 us steps)
+		lcd_puts_P(PSTR(" Ovr"));
+		lcd_put_uint(sched_overruns(), 4);
+	}
+}
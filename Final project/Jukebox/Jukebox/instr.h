@@ -0,0 +1,82 @@
+#ifndef INSTR_H
+#define INSTR_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// Latency instrumentation on the free-running Timer1 stamp (hal_stamp(),
+// 0.5 us per count): main-loop period and the work of each pass (the rest
+// of the period is IDLE sleep), run time of every ISR and the worst
+// delay of the 1 ms tick behind a window with interrupts off. All figures
+// are kept in stamps; instr_show() puts them on the hidden admin pages in us.
+//
+// The jukebox builds define JUKEBOX_INSTR (Jukebox.cproj, host and bench
+// Makefiles). twi.c is shared with Lab5 and the tester, which do not, and
+// there INSTR_ISR() is a plain ISR() and nothing links against instr.c.
+
+enum {
+	INSTR_TICK,                     // TIMER0_COMPA_vect
+	INSTR_ENC,                      // PCINT2_vect
+	INSTR_RX,                       // USART_RX_vect
+	INSTR_TX,                       // USART_UDRE_vect
+	INSTR_GAP,                      // TIMER2_COMPA_vect
+	INSTR_TWI,                      // TWI_vect
+	INSTR_BUSY,                     // PCINT0_vect (MP3_BUSY_PIN_IRQ only)
+	INSTR_ISRS
+};
+
+typedef struct {
+	uint16_t loop_min;              // main-loop period, wake to wake
+	uint16_t loop_max;              // 0xFFFF = a pass took longer than the stamp range
+	uint16_t loop_avg8;             // running mean x8, 1/8 weight per pass
+	uint16_t busy_max;              // work of one pass, wake to hal_idle()
+	uint16_t busy_avg8;             // running mean x8
+	uint16_t irq_off_max;           // tick ISR entry delay, 8 stamps (4 us) resolution
+	uint16_t isr_max[INSTR_ISRS];   // longest single run
+	uint16_t isr_avg8[INSTR_ISRS];  // running mean x8
+	uint32_t loops;
+} instrStats_t;
+
+#define INSTR_US(stamps) ((stamps) >> 1)
+#define INSTR_PAGES      3
+
+extern instrStats_t instr_stats;   // written by the ISRs and instr_loop(), read with instr_get()
+
+void instr_init(void);              // Timer1 on, stats cleared
+void instr_loop(void);              // once per main-loop pass, first thing after the wake-up
+void instr_loop_end(void);          // once per main-loop pass, just before hal_idle()
+void instr_get(instrStats_t *s);    // consistent copy
+void instr_reset(void);
+void instr_show(uint8_t page);      // draws one page into the LCD frame (no flush)
+
+static inline void instr_isr(uint8_t id, uint16_t d)
+{
+	if (d > instr_stats.isr_max[id]) instr_stats.isr_max[id] = d;
+	instr_stats.isr_avg8[id] += d - (instr_stats.isr_avg8[id] >> 3);
+}
+
+// Timer0 count at tick ISR entry: how long the compare match waited for the I bit
+static inline void instr_tick_entry(uint8_t count)
+{
+	uint16_t d = (uint16_t)count * 8;
+	if (d > instr_stats.irq_off_max) instr_stats.irq_off_max = d;
+}
+
+// INSTR_ISR(vect, id) { body } times the whole body, early returns included
+#ifdef JUKEBOX_INSTR
+#define INSTR_ISR(vect, id)                                                  \
+	static inline void vect##_body(void);                                \
+	ISR(vect)                                                            \
+	{                                                                    \
+		uint16_t t0_ = hal_stamp();                                  \
+		vect##_body();                                               \
+		instr_isr(id, hal_stamp() - t0_);                            \
+	}                                                                    \
+	static inline void vect##_body(void)
+#define INSTR_TICK_ENTRY() instr_tick_entry(hal_tick_count())
+#else
+#define INSTR_ISR(vect, id) ISR(vect)
+#define INSTR_TICK_ENTRY()
+#endif
+
+#endif
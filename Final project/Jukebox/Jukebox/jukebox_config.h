@@ -0,0 +1,89 @@
+//jukebox_config.h  -  central definitions shared by all modules
+
+#ifndef JBX_CONFIG_H
+#define JBX_CONFIG_H
+
+#define F_CPU 16000000UL      // 16MHz clock
+
+//RIFD--------------------------------------
+#define RFID_ADDR   0x13
+#define MAX_UID_LEN 6
+#define RFID_I2C_HZ 400000UL  // TWI fast mode (use 100000UL for standard mode)
+#define RFID_TIMEOUT_MS 10    // whole-transfer budget before bus recovery
+#define RFID_POLL_MS    50    // reader poll period (20 Hz)
+#define RFID_CACHE_LEN  4     // recently seen cards remembered
+#define RFID_HOLD_MS    1500  // a card must be away this long to count again
+#define RFID_BEACON_MS  250   // reader poll period while the jukebox is idle (4 Hz)
+
+//Music total # of songs (generated from the SD card by tools/mkcatalog.py, up to 255)
+#include "catalog_data.h"
+#define TOTAL_SONGS CATALOG_COUNT
+
+// SRAM: about RAM_FIXED bytes of .data/.bss do not depend on the catalog;
+// plays and shuffle add 3 bytes and a dirty bit per song (about 1760 bytes
+// at 255 songs). RAM_STACK_MIN is kept free for the stack, about twice the
+// deepest path (an admin statistics page drawn under one ISR). Re-check
+// RAM_FIXED with tools/memreport.py on an AVR build when modules grow.
+#define RAM_FIXED     980
+#define RAM_STACK_MIN 256
+#if RAM_FIXED + 3 * TOTAL_SONGS + (TOTAL_SONGS + 7) / 8 + RAM_STACK_MIN > 2048
+#error "catalog too large for the 2 KB SRAM of the ATmega328P"
+#endif
+
+//Rotary encoder (RPG)------------------------
+#define ENC_REST_STATE 3      // A/B level at a detent (both high with the pull-ups)
+#define ENC_MED_MS     80     // detents closer than this move ENC_MED_STEP songs
+#define ENC_MED_STEP   2
+#define ENC_FAST_MS    30     // detents closer than this move ENC_FAST_STEP songs
+#define ENC_FAST_STEP  5
+
+//Buttons (PD4 select, PD5 admin)------------
+#define BTN_SAMPLE_MS  5      // debounce sample period, a press is reported 4 samples after it settles
+#define BTN_LONG_MS    2000   // PD5 held this long = long press (shuffle toggle on release)
+#define BTN_HOLD_MS    ENROLL_PRESS_MS // PD5 held this long = card enrollment toggle
+#define BTN_DOUBLE_MS  300    // second press within this after a short one = double-click
+
+//Power---------------------------------------
+#define POWER_IDLE_MS    30000 // no input and nothing playing this long = idle
+#define POWER_AMP_OFF_MS 3000  // STA540 to standby this long after the music stops
+
+//EEPROM persistence----------------------------
+#define PERSIST_ADDR     0x000 // journal ring at the bottom of the 1 KB EEPROM
+#define PERSIST_SLOTS    16    // 8-byte records, each slot takes 1/16 of the writes
+#define PERSIST_BATCH_MS 1000  // changes within this window share one record
+#define PERSIST_MIN_MS   5000  // never two records closer than this
+
+//RFID card table (EEPROM)----------------------
+#define CARD_ADDR        0x080 // after the journal, up to PLAYS_ADDR
+#define CARD_SLOTS       91    // 7 bytes each (637 bytes), at most 255
+#define CARD_FLUSH_MS    300000 // balance changes within this window share one write per card
+#define ENROLL_PRESS_MS  5000  // admin mode: PD5 held this long toggles card enrollment (BTN_HOLD)
+
+//Play statistics (EEPROM)----------------------
+#define PLAYS_ADDR       0x300 // [magic][picks of SD track 1-255], the last 256 bytes
+#define PLAYS_FLUSH_MS   60000 // picks within this window go to the EEPROM together
+
+//ISR -> main event ring----------------------
+#define EVQ_LEN 32            // events, must be a power of two (a drain runs every wake-up)
+
+//Scheduler------------------------------------
+#define SCHED_MAX_TASKS 10    // periodic + one-shot task slots
+#define SCHED_BUDGET_US 2000  // a task running longer than this counts as an overrun
+
+//MP3 Trigger UART----------------------------
+#define MP3_TX_BUF_SIZE 32  // TX ring size in bytes, must be a power of two
+#define MP3_CMD_GAP_MS  3   // default quiet time after each command (0 = none)
+#define MP3_QUERY_MS    1000 // min time between 'Q' status queries while playing
+#define MP3_PLAY_HOLDOFF_MS 500 // ignore replies about the old track after a play
+#define MP3_BUSY_PIN_IRQ 0  // 1 = track BUSY (PB2) with a pin-change interrupt
+#define MP3_QUEUE_LEN   8   // paid selections waiting to play, must be a power of two
+#define MP3_BOOT_MS     100 // Trigger boot time, commands are held in the TX ring until then
+#define MP3_VOL_DEFAULT 0   // Trigger attenuation at power-up (0 = loudest), assumed until the first 'v'
+#define MP3_VOL_LEVELS  20  // admin volume steps on the knob, top step = MP3_VOL_DEFAULT
+#define MP3_VOL_STEP    4   // attenuation per volume step (Trigger units)
+
+// UIDs for cards 
+extern const char admin_uid[MAX_UID_LEN];
+extern const char user_uid [MAX_UID_LEN];
+
+#endif 
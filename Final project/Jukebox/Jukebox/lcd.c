@@ -0,0 +1,177 @@
+// lcd.c HD44780 driver (4-bit) with a shadow framebuffer and dirty-cell refresh
+
+#ifndef F_CPU
+#define F_CPU 16000000UL     // 16MHz clock (same board on every project)
+#endif
+
+#include "hal.h"             // LCD pins
+#include <util/delay.h>      // Avr Delay functions (boot init + E pulse)
+#include <avr/pgmspace.h>    // pgm_read_byte for flash strings
+#include <string.h>          // memset
+#include "lcd.h"             // Header file
+
+#define LCD_CELLS (LCD_ROWS * LCD_COLS)
+
+// ---------- Framebuffers
+static volatile char fb   [LCD_CELLS];  // what the UI wants on screen
+static volatile char shown[LCD_CELLS];  // what is on the glass right now
+static uint8_t cur = 0;                 // UI cursor (cell index)
+static volatile uint8_t hold  = 0;      // 1 while the UI is building a frame
+static volatile uint8_t dirty = 0;      // fb may differ from shown
+
+// ---------- Flush engine state (only touched by lcd_tick)
+static uint8_t eng_addr  = 0xFF;        // DDRAM address the LCD writes next (0xFF = unknown)
+static uint8_t eng_byte  = 0;           // byte in flight
+static uint8_t eng_phase = 0;           // 1 = low nibble still to send
+static uint8_t eng_scan  = 0;           // cell where the next scan starts
+static volatile uint8_t syncing = 0;    // lcd_sync() owns the engine, lcd_tick() stays out
+
+static void lcd_nibble(uint8_t n) //sends 4-bitt nibble
+{
+    hal_lcd_data(n); //put high nibble as unchanged
+    hal_lcd_e(1); //sets E = 1
+    _delay_us(1); // holds for a microsecond
+    hal_lcd_e(0); //E = 0 (data receieved)
+    _delay_us(1); //lets bus settle
+}
+
+static void lcd_command(uint8_t c)
+{
+    hal_lcd_rs(0);  //RS = 0 -> instruct register
+    lcd_nibble(c >> 4); //loads high 4 bits first
+    lcd_nibble(c & 0x0F); //loads low 4 bits
+    _delay_us(40); //gives some delay for commands to go through
+}
+
+static void lcd_data(uint8_t d)
+{
+    hal_lcd_rs(1); //RS = 1 -> data reg
+    lcd_nibble(d >> 4); //high nib
+    lcd_nibble(d & 0x0F); //low nib
+    _delay_us(40); //delay for commands
+}
+
+void lcd_init(void) { lcd_init_after(0); } //full power-up wait
+
+void lcd_init_after(uint8_t elapsed_ms) //initialize LCD, elapsed_ms of the power-up wait already spent elsewhere
+{
+    hal_lcd_init_pins(); //PC0-PC3 (D4-D7), PB0 (RS), PB1 (E) outputs
+    while(elapsed_ms++ < LCD_POWERUP_MS) _delay_ms(1); // waits for 50 ms after power up
+
+    lcd_nibble(0x03); _delay_ms(5); //delays for 8-bit mode
+    lcd_nibble(0x03); _delay_us(150);
+    lcd_nibble(0x03); _delay_us(150);
+
+    lcd_nibble(0x02); _delay_us(40); //switches to 4-bit mode
+
+    lcd_command(0x28); lcd_command(0x0C); //func set to 4-bitm 2 lines, 5x8
+    lcd_command(0x06); lcd_command(0x01); //display on, curser off, blinking off
+    _delay_ms(2); //clears
+
+    memset((char *)fb,    ' ', LCD_CELLS); //glass is blank after the clear command
+    memset((char *)shown, ' ', LCD_CELLS);
+    eng_addr = 0xFF;
+}
+
+void lcd_create_char(uint8_t loc, const uint8_t *map)
+{
+    lcd_command(0x40 | ((loc & 0x07) << 3)); //sets CGRAM address
+    for(uint8_t i=0;i<8;i++) lcd_data(map[i]); //writes 8bitmap rows
+    eng_addr = 0xFF; //DDRAM address is lost after a CGRAM write
+}
+
+// ---------- Framebuffer API (main loop side)
+void lcd_clear(void)
+{
+    hold = 1; //engine keeps the old frame on the glass until lcd_flush()
+    memset((char *)fb, ' ', LCD_CELLS);
+    cur = 0;
+}
+
+void lcd_gotoxy(uint8_t x, uint8_t y) { cur = (y ? LCD_COLS : 0) + x; } //row offset + column
+
+void lcd_putc(char c) { if(cur < LCD_CELLS) fb[cur++] = c; } //cells past the end are dropped
+
+void lcd_puts(const char *s) { while(*s) lcd_putc(*s++); } //prints C-string into the frame
+
+void lcd_puts_P(const char *s) //same from flash, the literal never gets a copy in SRAM
+{
+    char c;
+    while((c = pgm_read_byte(s++))) lcd_putc(c);
+}
+
+void lcd_put_uint(uint16_t v, uint8_t width) //decimal, right-aligned in width cells (0 = no padding)
+{
+    char d[5]; //65535 is the widest
+    uint8_t n = 0;
+    do { d[n++] = '0' + v % 10; v /= 10; } while(v);
+    while(width > n){ lcd_putc(' '); width--; }
+    while(n) lcd_putc(d[--n]);
+}
+
+void lcd_flush(void)
+{
+    dirty = 1;
+    hold  = 0;
+}
+
+uint8_t lcd_idle(void) { return !dirty && !eng_phase; }
+
+// ---------- Flush engine (timer ISR side)
+// Each call puts out one nibble, so the 37us HD44780 execution time has
+// always elapsed before the next byte starts. Only cells that differ from
+// the glass are written, and the DDRAM address is only set when the next
+// dirty cell does not follow the previous one.
+static void engine_step(void)
+{
+    if(eng_phase) //low half of the byte in flight
+    {
+        lcd_nibble(eng_byte & 0x0F);
+        eng_phase = 0;
+        return;
+    }
+    if(hold || !dirty) return;
+
+    uint8_t i = eng_scan, n = LCD_CELLS;
+    while(fb[i] == shown[i]) //find the next changed cell
+    {
+        if(++i >= LCD_CELLS) i = 0;
+        if(--n == 0){ dirty = 0; return; } //glass matches the frame
+    }
+    eng_scan = i;
+
+    uint8_t addr = (i >= LCD_COLS) ? 0x40 + i - LCD_COLS : i;
+    if(addr != eng_addr) //not contiguous, set DDRAM address first
+    {
+        hal_lcd_rs(0);
+        eng_byte = 0x80 | addr;
+        eng_addr = addr;
+    }
+    else
+    {
+        hal_lcd_rs(1);
+        eng_byte = fb[i];
+        shown[i] = eng_byte;
+        eng_addr++; //LCD auto-increments after a data write
+        eng_scan = (i + 1 < LCD_CELLS) ? i + 1 : 0;
+    }
+    lcd_nibble(eng_byte >> 4);
+    eng_phase = 1;
+}
+
+void lcd_tick(void)
+{
+    if(!syncing) engine_step();
+}
+
+// Boot only: runs the engine from the main loop at HD44780 speed instead
+// of one nibble per tick, so the first frame is up in ~3 ms, not ~70 ms
+void lcd_sync(void)
+{
+    syncing = 1;
+    do{
+        _delay_us(40); //a nibble the timer ISR just sent may still be executing
+        engine_step();
+    }while(!lcd_idle());
+    syncing = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef LCD_H
+#define LCD_H
+
+#include <stdint.h>
+
+// HD44780 16x2 in 4-bit mode, pins from hal.h. Shared with FinalProj_tester.
+
+#define LCD_COLS 16
+#define LCD_ROWS 2
+#define LCD_POWERUP_MS 50                          // HD44780 wait after Vcc comes up
+
+// Blocking setup, only used at boot before the UI starts
+void lcd_init(void);                               // HD44780 power-up, 4-bit mode
+void lcd_init_after(uint8_t elapsed_ms);           // same, part of the power-up wait already spent
+void lcd_create_char(uint8_t loc, const uint8_t *map); // CGRAM glyph 0-7
+
+// Shadow framebuffer: the UI draws here, the tick engine copies the
+// cells that changed onto the glass one nibble per lcd_tick()
+void lcd_clear(void);                              // start a new frame (all spaces, engine held)
+void lcd_gotoxy(uint8_t x, uint8_t y);             // move the frame cursor
+void lcd_putc(char c);                             // write one cell, advance cursor
+void lcd_puts(const char *s);                      // write a string from the cursor
+void lcd_puts_P(const char *s);                    // same for a PSTR() string in flash
+void lcd_put_uint(uint16_t v, uint8_t width);      // decimal, right-aligned, 0 = no padding
+void lcd_flush(void);                              // release the frame to the engine
+uint8_t lcd_idle(void);                            // 1 when the glass matches the frame
+
+void lcd_tick(void);                               // call every 1 ms from the timer ISR
+void lcd_sync(void);                               // blocking: put the pending frame on the glass now
+
+#endif
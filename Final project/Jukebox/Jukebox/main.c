@@ -1,71 +1,69 @@
 #define F_CPU 16000000UL //Setting frequency for delays
 
-#include <avr/io.h> // Register names for Ports, DDRC and stuff
+#include "hal.h" // pins, timers, UART, TWI (or the host simulator)
 #include <avr/interrupt.h> // ISR() vector
-#include <util/delay.h> //uses delay_ms and delay_us
-#include <util/twi.h> //I^2C register and macros
-#include <avr/wdt.h> //watchdog control
-#include <string.h> //memcmo, snprintf
-#include <stdio.h> // sprintf (LCD credit text)
-#include <stdlib.h> //rand+srand
+#include <string.h> //memcmp
+#include <avr/pgmspace.h> //PSTR: UI strings stay in flash
 
 #include "jukebox_config.h" //including other files
 #include "mp3.h"
-
-
-// ---------- LCD wiring & helper macros
-#define LCD_DATA_PORT PORTC //setting PC0-PC3 (4-bit mode)
-#define LCD_DATA_DDR  DDRC //setting data direction reg
-#define LCD_CTRL_PORT PORTB // PB0 =RS, PB1 = E
-#define LCD_CTRL_DDR  DDRB
-#define LCD_RS        PB0
-#define LCD_E         PB1
-#define OVERFLOWS_PER_SECOND 977 //Timer0 overflows at prescaler-64 for 1Hz
+#include "lcd.h"
+#include "twi.h"
+#include "rfid.h"
+#include "sched.h"
+#include "tick.h"
+#include "catalog.h"
+#include "shuffle.h"
+#include "power.h"
+#include "persist.h"
+#include "plays.h"
+#include "bootprof.h"
+#include "cards.h"
+#include "instr.h"
+#include "evq.h"
+#include "buttons.h"
+
+
+// ---------- UI timing (ms on the tick.c timebase)
+#define SNAP_BACK_MS  10000 //knob idle time before the display returns to the playing song
 // --------------------------------------------------------------
 
-// ---------- UIDs & song metadata (single defs) 
+// ---------- UIDs (song metadata lives in flash, see catalog.c)
+// Enrolled into the EEPROM card table on first boot; more cards are added in enroll mode
 const char admin_uid[MAX_UID_LEN] = {0x3A,0x00,0x6C,0x34,0xF9,0x9B}; //RFID codes for cards
 const char user_uid [MAX_UID_LEN] = {0x3A,0x00,0x6C,0x6D,0xBA,0x81};
 
-const char *titles[TOTAL_SONGS] = {
-    "Go Robot","Migra","Expresso","Sticky",
-    "Judas","Let It Be","Africa",
-    "Sweet Child","Thunderstruck","Yesterday"
-};
-const char *artists[TOTAL_SONGS] = {
-    "RHCP","Santana","Sabrina ","TylerTC",
-    "Lady Gaga","The Beatles","Toto",
-    "Guns N' R","AC/DC","The Beatles"
-};
-
 //Global---------------------------------------------------
-volatile int      song_index       = 0; //current posi of the RPG
+static int        song_index       = 0; //current posi of the RPG (main only, the ISR posts EVT_ENC)
 volatile int      selected_song    = -1; //Index of the track that is playing
-volatile uint8_t  update_display   = 1; //Flag that tells main to redraw LCD next time you can
-volatile uint32_t last_scroll_time = 0; //1 sec software clock incremented by Timer-0ISR for debouncing
-//long press/display scrolling
-volatile uint8_t  rpg_moved        = 0; // Set by RPG ISR when the knob turns to reset inactive timers
+static uint8_t    update_display   = 1; //Flag that tells main to redraw LCD next time you can
+static tick_t     knob_time        = 0; //tick_now() of the last detent, for the snap-back
+static uint8_t    buttons          = 0; //HAL_BTN_* held down, kept from the press/release gestures
+static volatile uint8_t tick_posted = 0; //an EVT_TICK is in the ring, the next tick need not post
 volatile uint8_t  no_credit_flag   = 0; //Indication that the user tried to play a song w/no credits
-volatile uint32_t no_credit_time   = 0; //Records the timer val when no_credit_flag was raised
-volatile uint8_t  credits          = 0; //Current credit balance
-volatile uint8_t  prev_credits     = 0; //stores the user's credit count so it can be restored when admin is toggled
+volatile tick_t   no_credit_time   = 0; //Records tick_now() when no_credit_flag was raised
+volatile uint8_t  credits          = 0; //Balance of the paying card (255 in admin mode)
+static uint8_t    active_card      = CARD_NONE; //card table slot of the last user card tapped
+static uint8_t    enroll_mode      = 0; //admin only: card taps add/remove cards
 volatile uint8_t  admin_mode       = 0; //toggle for admin mode that unlocks PD5 and bypasses credit checks
 volatile uint8_t  shuffle_mode     = 0; //For when shuffle is enabled via >2s pd5 press
-volatile uint32_t pd5_press_time   = 0; //timestamp for when PD5 is press, classifies short vs. long presses
-volatile uint32_t shuffle_grace_until = 0; //future time (s) after firmware can resume busy-polling
-volatile uint8_t track_finished = 0; //set by USART RX ISR for the mp3 trigger to send an 'X' byte
+static uint8_t    boot_diag        = 0; //PD5 held at power-up: show the boot report once the Trigger is up
+static uint8_t    skip_admin_evt   = 0; //release of that power-up hold is not a stop/shuffle press
+static uint8_t    diag_page        = 0; //next hidden diagnostic page (timing stats, then the boot report)
+static uint8_t    volume_mode      = 0; //admin double-click: the knob sets the volume while the screen is up
+static uint8_t    volume_level     = MP3_VOL_LEVELS; //0 (mute-ish) to MP3_VOL_LEVELS (Trigger power-up level)
+static uint8_t    popular_mode     = 0; //knob walks the songs most picked first instead of the catalog order
 
   
 
-static void shuffle_play_next(void) //starts a random track in shuffle
+static void shuffle_play_next(void) //starts the next track of the shuffle order
 {
-	selected_song = rand() % TOTAL_SONGS; //Picks a new random index
+	selected_song = shuffle_next(); //every song once per cycle, never twice in a row
 	song_index    = selected_song; // mirrors encoder pointer
-	mp3PlayTrack(selected_song + 1); //mp3 trigger is 1
+	power_amp_on(); //STA540 out of standby before the music starts
+	mp3PlayTrack(catalog_track(selected_song)); //SD card track number from the catalog
 	update_display = 1; //Forces LCD refresh   
-	
-	shuffle_grace_until = last_scroll_time + .5;
-	//Ignores busy polling for a half second so encoder can set busy flag
+	//mp3PlayTrack marks the player busy and ignores stale replies for a moment
 }
 
 
@@ -75,395 +73,485 @@ uint8_t music_icon[8] = {
     0b00101,0b11100,0b11100,0b00000
 };
 
-//LCD Driver stuff-----------------------------------------------------
-static void lcd_nibble(uint8_t n) //sends 4-bitt nibble
+//timer 0 (1 ms tick)-----------------------------------------------
+INSTR_ISR(TIMER0_COMPA_vect, INSTR_TICK)
 {
-    LCD_DATA_PORT = (LCD_DATA_PORT & 0xF0) | (n & 0x0F);//put high nibble as unchanged
-    LCD_CTRL_PORT |=  (1 << LCD_E); //sets E = 1
-    _delay_us(1); // holds for a microsecond
-    LCD_CTRL_PORT &= ~(1 << LCD_E); //E = 0 (data receieved)
-    _delay_us(1); //lets bus settle
+    INSTR_TICK_ENTRY(); //how late the compare match got in (masked windows)
+    tick_advance(); //1 ms monotonic clock, never reset
+    if(!tick_posted) tick_posted = evq_post(EVT_TICK, 0); //one pending tick wakes the scheduler
+    btn_tick(); //debounce and gestures, posts EVT_BUTTON
+    mp3Tick(); //MP3 status query schedule
+    lcd_tick(); //puts out one nibble of any pending LCD cell changes
+    twi_tick(); //times out a stuck RFID transfer
+    rfid_tick(); //queues an RFID poll every RFID_POLL_MS
 }
 
-static void lcd_command(uint8_t c)
+//RPG-------------------------------------------------------------------
+// Both channels are decoded on every edge (PCINT18/19 on PD2/PD3).
+// State = (A<<1)|B; clockwise runs 00 -> 10 -> 11 -> 01 -> 00.
+static const int8_t enc_table[16] = { //[prev<<2 | cur] -> -1, 0 (no move/glitch), +1
+     0, -1, +1,  0,
+    +1,  0,  0, -1,
+    -1,  0,  0, +1,
+     0, +1, -1,  0
+};
+
+static void encoder_init(void)
 {
-    LCD_CTRL_PORT &= ~(1 << LCD_RS);  //RS = 0 -> instruct register
-    lcd_nibble(c >> 4); //loads high 4 bits first
-	 lcd_nibble(c & 0x0F); //loads low 4 bits
-    _delay_us(40); //gives some delay for commands to go through
+    hal_encoder_init(); //PD2,PD3 inputs with pull-ups, pin-change on A and B
 }
 
-static void lcd_data(uint8_t d)
+
+INSTR_ISR(PCINT2_vect, INSTR_ENC) //Fires on any edge of RPG A or B
 {
-    LCD_CTRL_PORT |= (1 << LCD_RS); //RS = 1 -> data reg
-    lcd_nibble(d >> 4); //high nib
-	lcd_nibble(d & 0x0F); //low nib
-    _delay_us(40); //delay for commands
+    static uint8_t prev = ENC_REST_STATE; //last A/B state
+    static int8_t  acc  = 0; //quarter steps since the last detent
+    static uint16_t last_detent = 0; //tick_now() of the last detent (low half)
+
+    uint8_t cur = hal_encoder_ab(); //A = PD2 -> bit 1, B = PD3 -> bit 0
+    if(cur == prev) return; //edge on another PORTD pin
+    acc += enc_table[(prev << 2) | cur]; //illegal double-bit jumps add 0
+    prev = cur;
+
+    if(cur != ENC_REST_STATE) return; //only the detent position counts
+    int8_t dir = (acc >= 2) ? 1 : (acc <= -2) ? -1 : 0; //a detent is 4, or 2 with one edge missed
+    acc = 0; //bounce that went back and forth cancels out here
+    if(!dir) return;
+
+    //Acceleration: the faster the detents come, the further each one moves
+    uint16_t now = (uint16_t)tick_now();
+    uint16_t dt  = now - last_detent;
+    last_detent  = now;
+    uint8_t step = (dt < ENC_FAST_MS) ? ENC_FAST_STEP : (dt < ENC_MED_MS) ? ENC_MED_STEP : 1;
+    if(step >= TOTAL_SONGS) step = 1; //a whole lap (or more) would land on the same song
+
+    evq_post(EVT_ENC, (dir > 0) ? step : -step); //main moves song_index, no 16-bit write here
 }
 
-static void lcd_init(void) //initialize LCD
+
+//Display stuff
+static uint8_t msg_task = SCHED_NONE; //one-shot that ends a timed message, SCHED_NONE = song screen
+
+static void end_message(void) //message time is up, back to the song screen
 {
-    LCD_DATA_DDR |= 0x0F; //PC0-PC3 outputs (D4-D7)
-    LCD_CTRL_DDR |= (1 << LCD_RS) | (1 << LCD_E); //(PB0, PB1) outputs
-    _delay_ms(50); // waits for 50 ms after power up
-	
-    lcd_nibble(0x03); _delay_ms(5); //delays for 8-bit mode
-    lcd_nibble(0x03); _delay_us(150);
-    lcd_nibble(0x03); _delay_us(150);
-	
-    lcd_nibble(0x02); //switches to 4-bit mode
-	
-    lcd_command(0x28); lcd_command(0x0C); //func set to 4-bitm 2 lines, 5x8
-    lcd_command(0x06); lcd_command(0x01); //display on, curser off, blinking off
-    _delay_ms(2); //clears
+    msg_task = SCHED_NONE;
+    volume_mode = 0; //the volume screen is gone, the knob browses again
+    update_display = 1;
 }
 
-static void lcd_create_char(uint8_t loc, uint8_t *map)
+static void show_message(uint16_t ms) //keeps the frame just drawn up for ms, then redraws the song
 {
-    lcd_command(0x40 | ((loc & 0x07) << 3)); //sets CGRAM address
-    for(uint8_t i=0;i<8;i++) lcd_data(map[i]); //writes 8bitmap rows
+    lcd_flush(); //timer tick draws it
+    sched_cancel(msg_task); //a newer message restarts the timer
+    msg_task = sched_after(end_message, ms);
 }
 
-static void lcd_clear(void)                       { lcd_command(0x01); _delay_ms(2); } // erases all characters and resets DDRAM address to 0
-static void lcd_gotoxy(uint8_t x,uint8_t y)       { lcd_command(0x80 + (y?0x40:0) + x); } // sets DDRAM address/starts adresses low and 
-	//sets row offset
-static void lcd_putc(char c)                      { lcd_data(c); } //wrapper to forward one character  and handles RS line, 4-bit splits, and delay
-static void lcd_puts(const char*s){ while(*s) lcd_putc(*s++); } //pritns C-string to display one char at a time
-	//increments the pointer after each character
-	// relies on LCD_put c to get 40microsec delay per byte
-//timer 0(1Hz)-----------------------------------------------
-static void timer_init(void)
+static void show_admin_message(uint8_t on) //shows ADMIN ENABLED/DISABLED
 {
-    TCCR0A = 0; //clear control reg A
-    TCCR0B = (1 << CS01) | (1 << CS00);  //prescaler of 64 (16MHz/64 = 250KHz, overflow = 256 counts = 1024ms
-    TIMSK0 = (1 << TOIE0); //enables T0V0 interrupt so TIMER_OVF fires each overflow
-    TCNT0  = 0; //reset counter to start timing from zero immediately 
+    lcd_clear(); lcd_gotoxy(4,0); lcd_puts_P(PSTR("ADMIN"));
+    lcd_gotoxy(1,1); lcd_puts_P(on ? PSTR(" MODE ENABLED") : PSTR("MODE DISABLED"));
+    show_message(2500); //timed screen state instead of a 2.5s delay
 }
-ISR(TIMER0_OVF_vect)
+static void show_card_message(const char *msg) //one line from flash, for card table events
 {
-    static uint16_t cnt = 0; //16-bit accumulator 
-    if(++cnt >= OVERFLOWS_PER_SECOND)
-	{
-        last_scroll_time++; //increments global seconds counter
-		cnt = 0; // restarts 1-second window
-    }
+    lcd_clear(); lcd_gotoxy(0,0); lcd_puts_P(msg);
+    show_message(1500);
 }
-
-//USART shuffle control
-ISR(USART_RX_vect) //executes when a byte arrives on UART0      
+static void show_diag_page(void) //hidden admin pages: PD5 held while the knob turns
 {
-    uint8_t c = UDR0; //Read byte and clear RX flag
+    if(diag_page < INSTR_PAGES) instr_show(diag_page); //loop, ISR and irq-off timing
+    else boot_show();
+    diag_page = (diag_page + 1) % (INSTR_PAGES + 1);
+    show_message(5000);
+}
+static void show_volume(void) //admin volume screen, level and a bar
+{
+    lcd_clear(); lcd_gotoxy(0,0); lcd_puts_P(PSTR("Volume"));
+    lcd_gotoxy(13,0); lcd_put_uint(volume_level, 3);
+    lcd_gotoxy(0,1);
+    for(uint8_t i = 0; i < (uint16_t)volume_level * 16 / MP3_VOL_LEVELS; i++) lcd_putc('#');
+    show_message(3000); //every detent restarts it
+}
+static void display_song(int idx)
+{
+    lcd_clear(); // "now showing" func, starts a fresh frame
+    char name[CATALOG_NAME_MAX + 1]; //one name at a time, read from flash
 
-    if (c == 'X') //ASCII for Mp3 triggers "finished" message
-	{
-        track_finished = 1; //sets flag for main loop so chuffle can start   
+    catalog_title(idx, name);
+    lcd_gotoxy(0,0); lcd_puts(name); //first line (title)
+    catalog_artist(idx, name);
+    lcd_gotoxy(0,1); lcd_puts(name); //seconds line (artist
+    lcd_gotoxy(11,1); //right side shows credit info
+    if(enroll_mode) lcd_puts_P(PSTR("ENRL")); //taps add/remove cards
+    else{
+        lcd_puts_P(PSTR("C:"));
+        if(credits == 255) lcd_putc('I'); //I = infinite
+        else lcd_put_uint(credits, 0); //no snprintf/vfprintf in the image
     }
-    /* Debug:
-       else if (c == 'x') {  }   // cancelled by new command
-       else if (c == 'E') {  }   // track number error
-    */
+    if(idx == selected_song){ lcd_gotoxy(15,1); lcd_putc(0); } //marks currently played track
+		//adds custom music note thing
+    else{
+        uint8_t pos = mp3QueueFind(catalog_track(idx)); //waiting in the play queue?
+        if(pos){ lcd_gotoxy(15,1); lcd_put_uint(pos, 0); } //shows its place in line
+    }
+    lcd_flush(); //only the cells that changed get rewritten
 }
 
+//Tasks-----------------------------------------------------------------
+//Each runs to completion from sched_run(); none of them may block
 
-
-//RPG-------------------------------------------------------------------
-static void encoder_init(void)
+// RFID scan handler
+static void task_rfid(void)
 {
-    DDRD  &= ~((1<<PD2)|(1<<PD3)); //set PD2,PD3 as input
-    PORTD |=  (1<<PD2)|(1<<PD3);//enable pull-ups      
-    EICRA |=  (1<<ISC01)|(1<<ISC00); // INT0 triggers on rising edge    
-    EIMSK |=  (1<<INT0); //enable external interrupt 0
-}
+	char uid[MAX_UID_LEN];
 
+	// Check for a newly presented card (polled in the background, repeats filtered)
+	if(!rfid_read_uid(uid)) return;
+	power_activity();	// Someone is at the machine, reader back to full rate
 
-ISR(INT0_vect) //Fires on rising edge of RPG A pin
-{
-    uint8_t A = (PIND >> PD2) & 1; //read current logic level A
-    uint8_t B = (PIND >> PD3) & 1; //read B phase
-	
-    song_index = (A != B) // if A != B, the knob is clockwise
-	 ? (song_index+1)%TOTAL_SONGS //finds next title
-     : (song_index?song_index-1:TOTAL_SONGS-1); //else for counter clockwise
-	 
-    last_scroll_time = 0; //reset inactivity timer (for auto snap back to song)
-    rpg_moved = 1; //flags main loop that the knob has been turned
-    update_display = 1; //requests LCD refresh
-}
-
+	uint8_t slot = cards_find(uid);	// EEPROM card table, hashed by UID
 
-//Button Logic
-#define BTN_SELECT PD4 //play/select button
-#define BTN_ADMIN  PD5 //admin stop/shuffle button
+	// Enrollment: a tap adds an unknown card or removes an enrolled one
+	if(enroll_mode)
+	{
+		if(slot == CARD_NONE){
+			slot = cards_add(uid, CARD_USER);
+			show_card_message(slot == CARD_NONE ? PSTR("Card table full") : PSTR("Card added"));
+		}
+		else if(cards_role(slot) == CARD_ADMIN){
+			enroll_mode = 0;		// admin card ends enrollment
+			show_card_message(PSTR("Enroll done"));
+		}
+		else{
+			cards_remove(slot);
+			if(slot == active_card) active_card = CARD_NONE;
+			show_card_message(PSTR("Card removed"));
+		}
+		update_display = 1;
+		return;
+	}
 
-static void button_init(void) //initilization for GPIO setup
-{
-    DDRD  &= ~((1<<BTN_SELECT)|(1<<BTN_ADMIN));  // inputs
-    PORTD |=  (1<<BTN_SELECT)|(1<<BTN_ADMIN);    // pull?ups
+	if(slot == CARD_NONE)
+	{
+		show_card_message(PSTR("Unknown card"));
+	}
+	// Admin card detected
+	else if(cards_role(slot) == CARD_ADMIN)
+	{
+		// if not in admin mode it will enter it
+		if(!admin_mode){
+			credits = 255; 		// Grant 255 which is nearly infinite credits for pratical use
+			admin_mode = 1;		// Set admin mode flag to 1 to show it is currently on
+			show_admin_message(1);	// Display message that admin is on
+		}
+		// If it is in admin mode it will exit it
+		else{
+			admin_mode = 0;	    // Set admin mode flag to 0
+			credits = active_card == CARD_NONE ? 0 : cards_balance(active_card); // back to the paying card
+			show_admin_message(0);  // Show admin off message
+		}
+	}
+	// A user card adds a credit to its own balance and becomes the paying card
+	else if(!admin_mode){
+		active_card = slot;
+		uint8_t bal = cards_balance(slot);
+		if(bal < CARD_MAX_CREDITS) cards_set_balance(slot, ++bal);
+		credits = bal;
+	}
+	update_display = 1; // Flag to show that the LCD needs to update
 }
 
-static uint8_t btn_select_pressed(void) //edge detector for PD4
+// PD5 gestures, only acted on in admin mode
+static void on_admin_button(uint8_t g)
 {
-    static uint8_t last = 1; //remembers previous sampled state
-    uint8_t cur = PIND & (1<<BTN_SELECT); //
-    if(!cur && last) //Transitions from high to low
+	static uint8_t admin_long = 0;		// this press went past BTN_LONG_MS
+
+	if(g == BTN_PRESS){ skip_admin_evt = 0; admin_long = 0; }	// a new press is always a real one
+	if(skip_admin_evt || !admin_mode) return;
+
+	switch(g)
 	{
-		 _delay_ms(50); last = 0; //50ms debounce
-		 return 1; //reports a new press
+	case BTN_CLICK:                         // short press => stop
+		mp3Stop();
+		update_display = 1;		// Flag to show that the LCD needs to update
+		break;
+	case BTN_DOUBLE:                        // double-click => volume on the knob
+		volume_mode = 1;
+		show_volume();
+		break;
+	case BTN_LONG:                          // long press => shuffle on release, unless it becomes a hold
+		admin_long = 1;
+		break;
+	case BTN_HOLD:                          // very long press => card enrollment toggle
+		admin_long = 0;
+		enroll_mode ^= 1;
+		show_card_message(enroll_mode ? PSTR("Enroll: tap card") : PSTR("Enroll done"));
+		update_display = 1;
+		break;
+	case BTN_RELEASE:
+		if(!admin_long) break;
+		admin_long = 0;
+		shuffle_mode ^= 1;		// Toggle the shuffle mode
+		lcd_clear(); 			// Clear the LCD disply
+		lcd_gotoxy(3,0);		// Move the cursor to the correct position
+		lcd_puts_P(shuffle_mode ? PSTR("Shuffle ON") : PSTR("Shuffle OFF"));  // Display shuffle on or shuffle off
+		show_message(1000);		// Show the status for 1 second, then the song
+
+		// If we just turned shuffle ON and no track is playing, start one
+		if(shuffle_mode && !mp3IsBusy()){
+			shuffle_play_next();	// Start playing a randomly selected song
+		}
+		break;
 	}
-    if( cur) last = 1; //button was released
-    return 0;
 }
 
-//returns: 0no event, 1short (<2s), 2long
-static uint8_t btn_admin_event(void)
+// PD4 pressed: play or queue the song on the screen
+static void on_select(void)
 {
-    static uint8_t  last = 1; //tracks previous logic
-    static uint32_t t0   = 0; //time stamp of btn press
-
-    uint8_t cur = PIND & (1<<BTN_ADMIN);
-    if(!cur && last){   // pressed
-        t0   = last_scroll_time; //saves press time
-        last = 0;
-    }else if(cur && !last){ // released
-        uint32_t dt = last_scroll_time - t0; //tracks # of seconds held
-        last = 1;
-        return (dt >= 2) ? 2 : 1; //classifies duration
-    }
-    return 0; //no press
+	// If there are credits available or we are in admin mode
+	if(credits > 0 || admin_mode)
+	{
+		// Plays now if the player is idle, else waits its turn behind the paid queue
+		power_amp_on();
+		uint8_t pos = mp3Queue(catalog_track(song_index));
+		if(pos == MP3_QUEUE_FULL){
+			lcd_clear(); lcd_gotoxy(3,0); lcd_puts_P(PSTR("Queue full"));
+			show_message(1000);		// Nothing queued, so no credit is taken
+			return;
+		}
+		plays_count(song_index);		// what customers pick, for the popularity order
+		// Deduct one credit if not in admin mode
+		if(!admin_mode && credits != 255) {
+			credits--;
+			cards_set_balance(active_card, credits);	// spent from the paying card
+		}
+		if(pos == 0){
+			selected_song = song_index;	// Store the current song index as the selected song
+		}else{
+			lcd_clear(); lcd_gotoxy(4,0); lcd_puts_P(PSTR("Queued #"));
+			lcd_put_uint(pos, 0);		// Place in line
+			show_message(1000);
+		}
+	}
+	else  // If the user has no credits
+	{
+		no_credit_flag = 1;			// Set the flag to indicate that the user has no credits left
+		no_credit_time = tick_now();		// Record the time when the user ran out of credits
+	}
+	update_display = 1;	// Set flag to update the display with the latest info
 }
 
-//I^2C stuff--------------------------------------------------
-static void i2c_init(void)
+// Button gesture from buttons.c (EVT_BUTTON)
+static void on_button(uint8_t evt)
 {
-    TWBR = 0x48; //bit rate register; 16MHz -100kHz          
-    TWCR = (1 << TWEN); //enables TWI hardware 
+	uint8_t mask = BTN_EVT_MASK(evt), g = BTN_EVT_GESTURE(evt);
+
+	if(g == BTN_PRESS){ buttons |= mask; power_activity(); }	// someone is at the machine
+	if(g == BTN_RELEASE) buttons &= ~mask;
+
+	if(mask == HAL_BTN_ADMIN) on_admin_button(g);
+	else if(g == BTN_PRESS && admin_mode && (buttons & HAL_BTN_ADMIN)){
+		// Admin with PD5 held: PD4 switches the browse order instead of picking
+		skip_admin_evt = 1;			// letting go of PD5 is not a stop/shuffle press
+		popular_mode ^= 1;
+		if(popular_mode) song_index = plays_ranked(0);	// start at the most picked song
+		lcd_clear(); lcd_gotoxy(0,0); lcd_puts_P(PSTR("Browse by"));
+		lcd_gotoxy(0,1); lcd_puts_P(popular_mode ? PSTR("popularity") : PSTR("track number"));
+		show_message(1000);
+	}
+	else if(g == BTN_PRESS) on_select();		// PD4 acts on the debounced press, no delay
 }
 
-static uint8_t i2c_start(uint8_t addr) //generates START and SLA + R/W
+// One knob detent (EVT_ENC), step already accelerated by the ISR
+static void on_knob(int8_t step)
 {
-    TWCR = (1<<TWSTA)|(1<<TWEN)|(1<<TWINT); //sends START
-    while(!(TWCR & (1<<TWINT))); //waits until complete (status reg now holds START)
-    TWDR = addr; //loads slave address byte
-    TWCR = (1<<TWEN)|(1<<TWINT); // clears INT to start TX
-    while(!(TWCR & (1<<TWINT))); //waits for ACK/NACK
-    return (TWSR & 0xF8); //returns status upper bits
+	knob_time = tick_now(); 		// Update the time of the last RPG movement
+	power_activity();
+
+	// Admin with PD5 held: the knob pages through the diagnostics instead of the songs
+	if(admin_mode && (buttons & HAL_BTN_ADMIN)){
+		skip_admin_evt = 1;		// letting go of PD5 is not a stop/shuffle press
+		show_diag_page();
+		return;
+	}
+	// Volume screen up: the knob sets the level, the Trigger gets only the last one
+	if(volume_mode){
+		int16_t v = volume_level + (step > 0 ? 1 : -1);	// no acceleration, 20 levels only
+		volume_level = (v < 0) ? 0 : (v > MP3_VOL_LEVELS) ? MP3_VOL_LEVELS : v;
+		mp3SetVolume((MP3_VOL_LEVELS - volume_level) * MP3_VOL_STEP + MP3_VOL_DEFAULT);
+		show_volume();
+		return;
+	}
+	if(popular_mode)	// same walk over the popularity order, song_index stays a catalog index
+		song_index = plays_ranked((plays_rank(song_index) + TOTAL_SONGS + step) % TOTAL_SONGS);
+	else
+		song_index = (song_index + TOTAL_SONGS + step) % TOTAL_SONGS;	// |step| < TOTAL_SONGS
+	update_display = 1;			// requests LCD refresh
 }
 
-static void i2c_stop(void) //stop condition
+// Encoder turn logic: snaps the browse pointer back to the playing song
+static void task_encoder(void)
 {
-    TWCR = (1<<TWSTO)|(1<<TWEN)|(1<<TWINT); //requests stop
-    while(TWCR & (1<<TWSTO)); //waits until the bus is released
+	// If a song is selected and the song index is different from the selected song,
+	// and SNAP_BACK_MS has passed since the last RPG movement
+	if(selected_song != -1 && song_index != selected_song &&
+	tick_elapsed(knob_time) >= SNAP_BACK_MS)
+	{
+		song_index = selected_song;			// Update the song index with the selected song
+		update_display = 1;				// Set the flag to update the display with the new song
+	}
 }
 
-static uint8_t i2c_read(uint8_t ack) //read one byte with an optional ACK
+// MP3 Trigger status
+static void task_player(void)
 {
-    TWCR = (1<<TWEN)|(1<<TWINT)|(ack?1<<TWEA:0); //sets/ckears ack bit
-    while(!(TWCR & (1<<TWINT))); //waits to receive
-    return TWDR; //returns the byte
+	mp3Service();				// Sends a rate-limited 'Q' if one is due
+
+	// Last boot stage: Trigger booted and the power-up state query is out
+	if(boot_ms(BOOT_TRIGGER) == BOOT_PENDING && mp3TxIdle()){
+		boot_mark(BOOT_TRIGGER);
+		if(boot_diag){ boot_show(); show_message(5000); }
+	}
 }
 
-static uint8_t read_rfid_uid(char *uid)
+// One Trigger reply (EVT_MP3): 'X', 'E', Q reply or BUSY edge from the RX parser
+static void on_player(uint8_t mp3_evt)
 {
-    if(i2c_start(RFID_ADDR<<1) != 0x18) //sends SLA +W, expects ACK
+	// A queued selection was started by the RX ISR, follow it on the display
+	if(mp3_evt & MP3_EVT_STARTED)
 	{
-		 i2c_stop(); return 0; //if it failed, gives up
+		selected_song = catalog_find(mp3GetState().track);
+		update_display = 1;
 	}
-	
-    i2c_stop(); //WRITE PHASE is finished
-	
-    if(i2c_start((RFID_ADDR<<1)|1) != 0x40) //repeated-START, SLA+R. expects an ACK
+
+	// If shuffle mode is on and the player just went idle (song finished, queue empty);
+	// an admin stop (HALTED) stays stopped until the next pick or shuffle toggle
+	if(shuffle_mode && (mp3_evt & MP3_EVT_STOPPED) && !(mp3_evt & MP3_EVT_HALTED))
 	{
-		 i2c_stop(); return 0; 
+		shuffle_play_next();		// Play the next random song
 	}
-	
-    for(uint8_t i=0;i<MAX_UID_LEN;i++)
-        uid[i] = i2c_read(i < MAX_UID_LEN-1); //Acknowledges everything but last byte
-    i2c_stop(); return 1; //it worked
 }
 
-//Display stuff
-static void show_admin_message(uint8_t on) //shows ADMIN ENABLED/DISABLED
+// Empties the ISR event ring in batches; returns 1 if a tick went by
+static uint8_t drain_events(void)
 {
-    lcd_clear(); lcd_gotoxy(4,0); lcd_puts("ADMIN");
-    lcd_gotoxy(1,1); lcd_puts(on?" MODE ENABLED":"MODE DISABLED");
-    _delay_ms(2500);
+	evt_t ev[8];
+	uint8_t n, tick = 0;
+	while((n = evq_drain(ev, sizeof ev / sizeof ev[0])))
+	{
+		for(uint8_t i = 0; i < n; i++)
+		{
+			switch(ev[i].type)
+			{
+			case EVT_TICK:   tick_posted = 0; tick = 1;    break;
+			case EVT_ENC:    on_knob((int8_t)ev[i].data);   break;
+			case EVT_BUTTON: on_button(ev[i].data);         break;
+			case EVT_MP3:    on_player(ev[i].data);         break;
+			}
+		}
+	}
+	return tick;
 }
-static void display_song(int idx)
+
+// Journals credits and modes; persist.c batches the changes into rare EEPROM records
+static void task_persist(void)
 {
-    lcd_clear(); // "now showing" func
-    const char *t = titles [idx]; //looks up title/artist by the index
-    const char *a = artists[idx];
+	persistState_t st = {
+		.credits      = credits,
+		.card         = active_card,
+		.flags        = (admin_mode ? PERSIST_ADMIN : 0) | (shuffle_mode ? PERSIST_SHUFFLE : 0) |
+		                (popular_mode ? PERSIST_POPULAR : 0),
+		.song         = (selected_song < 0) ? 0xFF : selected_song,
+	};
+	persist_save(&st);		// no-op unless something changed
+	persist_task();			// writes at most one byte per call
+	plays_task();			// pick counts, same pacing
+	cards_task();			// card balances, same pacing
+}
 
-    lcd_gotoxy(0,0); lcd_puts(t); //first line (title)
-    lcd_gotoxy(0,1); lcd_puts(a); //seconds line (artist
-    lcd_gotoxy(11,1); //right side shows credit info
-    if(credits == 255) lcd_puts("C:I"); //I = infinite
-    else{
-        char b[6]; snprintf(b,sizeof(b),"C:%u",credits); lcd_puts(b);  //converts number to text
-    }
-    if(idx == selected_song){ lcd_gotoxy(15,1); lcd_putc(0); } //marks currently played track
-		//adds custom music note thing
+// Restores the journaled state after a reset or brown-out
+static void restore_state(void)
+{
+	persistState_t st;
+	if(!persist_load(&st)) return;		// blank EEPROM, factory defaults
+	if(cards_valid(st.card) && cards_role(st.card) == CARD_USER) active_card = st.card;
+	admin_mode   = (st.flags & PERSIST_ADMIN) != 0;
+	// The journal is written within seconds, the card table in batches minutes apart
+	if(!admin_mode && active_card != CARD_NONE && st.credits <= CARD_MAX_CREDITS)
+		cards_set_balance(active_card, st.credits);
+	credits      = admin_mode ? 255 : active_card == CARD_NONE ? 0 : cards_balance(active_card);
+	shuffle_mode = (st.flags & PERSIST_SHUFFLE) != 0;
+	popular_mode = (st.flags & PERSIST_POPULAR) != 0;
+	if(st.song < TOTAL_SONGS) song_index = st.song;	// browse from the last pick, nothing is playing yet
+}
+
+// Refresh display if update_display is flagged (and no message owns the screen)
+static void task_display(void)
+{
+	if(update_display && msg_task == SCHED_NONE){
+		update_display = 0;		// Clear update flag
+		display_song(song_index);	// Show the currently selected song on the LCD
+	}
 }
 
 //MAIN
 int main(void)
 {
-	//disable watchdog timer after reset
-	MCUSR = 0;
-	wdt_disable();
-
-	// Initializes: LCD, I2C, Rotary Encoder, Buttons, Timer, MP3 player
-	lcd_init();
-	lcd_create_char(0,music_icon);
-	i2c_init();
-	encoder_init();
-	button_init();
-	timer_init();
-	mp3Init(38400);
+	//disable watchdog timer until the slow blocking setup is done
+	hal_wdt_off();
 
-	// configure MP3 BUSY pin (PB2) as input
-	DDRB  &= ~(1<<PB2);
-	PORTB |=  (1<<PB2);
+	// Overlapped bring-up: the Trigger's 100 ms boot wait runs on Timer2 and
+	// the LCD's 50 ms power-up wait on the tick while everything else starts
+	tick_init();                     // 1 ms clock, boot stages are timed from here
+	mp3Init(38400);                  // status query 'Q' held in the TX ring until the Trigger is up
 
-	sei();                           // enable global interrupts
-	srand(12);                       // Set seed for shuffle mode
+	twi_init(RFID_I2C_HZ);
+	encoder_init();
+	btn_init();                      // buttons held now only report their release
+	shuffle_init(shuffle_entropy()); // new shuffle order every power-up
+	power_init();                    // amplifier in standby, unused peripherals off
+	instr_init();                    // Timer1 stamp for the latency statistics
+	hal_irq_on();                    // every peripheral set up: enable global interrupts
+	boot_mark(BOOT_INPUTS);
+	cards_init();                    // card table (seeded with the built-in cards on a blank EEPROM)
+	restore_state();                 // credits, modes and song from the EEPROM journal
+	plays_init();                    // pick counts and the popularity order
+	boot_mark(BOOT_RESTORE);
+
+	tick_t up = tick_now();          // LCD power-up wait already spent on the above
+	lcd_init_after(up < LCD_POWERUP_MS ? up : LCD_POWERUP_MS);
+	lcd_create_char(0,music_icon);
+	boot_mark(BOOT_LCD);
 
 	// Display the first song on startup
 	display_song(song_index);
+	lcd_sync();                      // straight onto the glass, not one nibble per ms
 	update_display = 0;
+	boot_mark(BOOT_FRAME);
+
+	buttons   = hal_buttons();
+	boot_diag = skip_admin_evt = (buttons & HAL_BTN_ADMIN) != 0;
+	if(shuffle_mode) shuffle_play_next();   // shuffle survives a reset
 
-	// Tracks when RPG was last moved
-	uint32_t last_rpg_time = 0;
+	// Task table (periods in ms)
+	sched_every(task_rfid,    10);
+	sched_every(task_encoder, 10);
+	sched_every(task_player,  10);
+	sched_every(task_display, 20);
+	sched_every(power_task,   100);
+	sched_every(task_persist, 10);
+
+	hal_wdt_on();                    // a hung loop resets, and the journal brings the state back
 
 	// Infinite loop
 	while(1)
 	{
-		//RFID scan handler
-		char uid[MAX_UID_LEN];
-
-		// Check for new RFID scan
-		if(read_rfid_uid(uid))
-		{
-			// Admin card detected
-			if(!memcmp(uid,admin_uid,MAX_UID_LEN))
-			{
-				// if not in admin mode it will enter it
-				if(!admin_mode){
-					prev_credits = credits;	// Store current credits
-					credits = 255; 		// Grant 255 which is nearly infinite credits for pratical use
-					admin_mode = 1;		// Set admin mode flag to 1 to show it is currently on
-					show_admin_message(1);	// Display message that admin is on
-				}
-				// If it is in admin mode it will exit it
-				else{
-					credits = prev_credits; // Restore previous credits
-					admin_mode = 0;	    // Set admin mode flag to 0
-					show_admin_message(0);  // Show admin off message
-				}
-			}
-			// If the user card is used while not in admin mode it will at a credit
-			else if(!memcmp(uid,user_uid,MAX_UID_LEN) && !admin_mode){
-				if(credits < 254) credits++;	// Increases user credit if under the limit of 255
-			}
-			update_display = 1; // Flag to show that the LCD needs to update
-			_delay_ms(1000);	// Delay to be able to show feedback
-		}
-
-		//Admin button (PD5) lgoic
-		
-		//Checks if admin button was pressed and if it was short or long press
-		uint8_t ad_evt = btn_admin_event();
-
-		// if the event is triggered and admin mode is active
-		if(ad_evt && admin_mode)
-		{
-			if(ad_evt == 1){                    // short press => stop
-				mp3Stop();
-				}else{                              // long press => shuffle toggle
-				shuffle_mode ^= 1;		// Toggle the shuffle mode
-				lcd_clear(); 			// Clear the LCD disply
-				lcd_gotoxy(3,0);		// Move the cursor to the correct position
-				lcd_puts(shuffle_mode ? "Shuffle ON" : "Shuffle OFF");  // Display shuffle on or shuffle off
-				_delay_ms(1000);		// Wait for 1 second to show the status
-
-				// If we just turned shuffle ON and no track is playing, start one
-				if(shuffle_mode && !mp3IsBusy()){
-					shuffle_play_next();	// Start playing a randomly selected song
-				}
-			}
-			update_display = 1;			// Flag to show that the LCD needs to update
-		}
-
-		//User select button (PD4)
-		// Check if the user select button (PD4) is pressed
-		if(btn_select_pressed())
-		{
-			// If there are credits available or we are in admin mode
-			if(credits > 0 || admin_mode)
-			{
-				// Deduct one credit if not in admin mode
-				if(!admin_mode && credits != 255) {
-					credits--;
-				}
-				selected_song = song_index;	// Store the current song index as the selected song
-				mp3PlayTrack(selected_song + 1); // Play the selected song
-			}
-			else  // If the user has no credits
-			{
-				no_credit_flag = 1;			// Set the flag to indicate that the user has no credits left
-				no_credit_time = last_scroll_time;	// Record the time when the user ran out of credits
-			}
-			update_display = 1;	// Set flag to update the display with the latest info
-			
-		}
-
-
-		//Encoder turn logic
-		
-		// Check if the rpg has mpved
-		if(rpg_moved){
-			last_rpg_time = last_scroll_time; 	// Update the time of the last RPG movement
-			rpg_moved = 0; 				// Reset the RPG moved flag
-		}
-
-		// If a song is selected and the song index is different from the selected song,
-		// and enough time (10ms or more) has passed since the last RPG movement
-		if(selected_song != -1 && song_index != selected_song &&
-		(last_scroll_time - last_rpg_time) >= 10)
-		{
-			song_index = selected_song;			// Update the song index with the selected song
-			last_scroll_time = last_rpg_time = 0;	// Reset the times to 0
-			update_display = 1;				// Set the flag to update the display with the new song
-		}
-
-		// shuffling pick a new song only after the last one ends
-		static uint8_t busy_prev = 1;            // remember last BUSY level
-		uint8_t busy_now = mp3IsBusy();		// Get current BUSY status (1 = playing, 0 = idle)
-
-		// If shuffle mode is on, and we detect a falling edge on BUSY (song just finished)
-		if(shuffle_mode && !busy_now && busy_prev)
-		{
-			selected_song = rand() % TOTAL_SONGS;	// Randomly pick a new song index
-			song_index    = selected_song;		// Update the current song index
-			mp3PlayTrack(selected_song + 1);		// Play the selected song
-			update_display = 1;                      // Flag display for update
-		}
-		busy_prev = busy_now;				// Store current BUSY state for next loop
-
-
-		// SHUFFLE based on X message
-		if(shuffle_mode && track_finished)	// If a song ended and shuffle is enabled
-		{
-			track_finished = 0;		// Clear the track finished flag
-			shuffle_play_next();		// Play the next random song
-		}
-
-		// Refresh display if update_display is flagged
-		if(update_display){
-			update_display = 0;		// Clear update flag
-			display_song(song_index);	// Show the currently selected song on the LCD
-		}
-
+		instr_loop();            // loop period, wake to wake
+		if(drain_events())       // knob, buttons and Trigger replies first, in order
+			sched_run();     // then whichever tasks are due (only after a tick)
+		hal_wdt_kick();          // this pass got through its work
+		instr_loop_end();        // work of this pass, without the sleep
+		hal_idle();              // sleeps until the next interrupt (1 ms tick at the latest)
 	}
 }
 
@@ -474,6 +562,8 @@ int main(void)
 //A	PD2
 //B	PD3
 //C GND
+//STA540 amplifier
+//STBY	PD6 (high = on)
 //| LCD Pin | Name | Connect To        | Notes                       |
 //|---------|------|-------------------|-----------------------------|
 //| 1       | VSS  | GND               | Ground                      |
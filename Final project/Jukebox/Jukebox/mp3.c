@@ -1,73 +1,454 @@
 // mp3.c low?level UART helper for SparkFun MP3 Trigger v2.4
 
 #include "jukebox_config.h"  // Includes code from jukebox_config.h
-#include <avr/io.h>	     // AVR I/O register definitions
-#include <util/delay.h>	     // Avr Delay functions
+#include "hal.h"             // UART, Timer2, BUSY pin
+#include <avr/interrupt.h>   // ISR() vector
+#include <util/atomic.h>     // ATOMIC_BLOCK for shared TX state
 #include "mp3.h"	     // Header file
+#include "instr.h"           // INSTR_ISR() run-time stamps
+#include "evq.h"             // EVT_MP3 to the main loop
+#include "catalog.h"         // per-track gain
 
 // Macro to do math to find the UBRR value for a given baud rate
 #define MP3_SERIAL_UBRR(b)  ((F_CPU / (16UL * (b))) - 1)
 
-// Sends a single byte over USART0
-static void usartSendByte(uint8_t c)
+// ---------- TX ring buffer
+// Commands are stored as frames: [len][gap_ms][byte 0]..[byte len-1]
+// The UDRE ISR drains one byte per interrupt; after the last byte of a
+// frame Timer2 counts gap_ms before the next frame is allowed out.
+#define MP3_TX_MASK (MP3_TX_BUF_SIZE - 1)
+
+static volatile uint8_t tx_buf[MP3_TX_BUF_SIZE];
+static volatile uint8_t tx_head    = 0;  // next free slot (written by main)
+static volatile uint8_t tx_tail    = 0;  // next byte to send (written by ISR)
+static volatile uint8_t tx_left    = 0;  // bytes still to send in current frame
+static volatile uint8_t tx_gap     = 0;  // pacing gap after current frame (ms)
+static volatile uint8_t tx_pacing  = 0;  // 1 while Timer2 is holding the line
+
+// ---------- Coalesced commands
+// Volume and track requests are not queued as frames: they overwrite one
+// pending value each, and flushPending() turns whatever is newest into
+// frames when the line frees up (or right before the next queued command,
+// to keep the order). A knob spun through 20 volume steps while a frame
+// is in flight sends one 'v', and a new pick replaces an unsent one.
+#define PEND_VOL   0x01
+#define PEND_TRACK 0x02
+#define PEND_STOP  0x04          // 'O', only if the Trigger is playing and no track is pending
+
+static volatile uint8_t pend       = 0;  // PEND_* bits
+static volatile uint8_t pend_track = 0;
+static volatile uint8_t vol_master = MP3_VOL_DEFAULT; // attenuation set by mp3SetVolume()
+static volatile uint8_t vol_sent   = MP3_VOL_DEFAULT; // what the Trigger was last told
+static volatile int8_t  cur_gain   = 0;  // catalog gain of the track last sent
+
+// What the Trigger itself is doing, as far as the bytes sent and received
+// tell. 'O' toggles, so a stop is only correct when it is known to play;
+// 'T'/'t' cancel whatever plays, so a pick never needs a stop first.
+enum { TRIG_UNKNOWN, TRIG_IDLE, TRIG_PLAYING };
+static volatile uint8_t trig = TRIG_UNKNOWN;  // until the power-up 'Q' is answered
+
+// ---------- Cached Trigger state (updated from RX/PCINT ISRs)
+static volatile mp3State_t state;
+static volatile uint16_t query_timer = 0;  // ms until the next 'Q' may go out
+static volatile uint16_t holdoff     = 0;  // ms to ignore stale replies after a play
+static volatile uint8_t  query_due   = 0;  // set by mp3Tick(), sent by mp3Service()
+static volatile uint8_t  halted      = 0;  // mp3Stop(): the queue waits for the next pick
+
+// ---------- Play queue (paid selections waiting for the current track)
+#define MP3_QUEUE_MASK (MP3_QUEUE_LEN - 1)
+static volatile uint8_t play_q[MP3_QUEUE_LEN];
+static volatile uint8_t pq_head  = 0;      // oldest entry
+static volatile uint8_t pq_count = 0;
+
+static uint8_t tx_pop(void)              // only called from the UDRE ISR
+{
+	uint8_t c = tx_buf[tx_tail];
+	tx_tail = (tx_tail + 1) & MP3_TX_MASK;
+	return c;
+}
+
+static void flushPending(void);
+static void setStopped(uint8_t ev);
+
+INSTR_ISR(USART_UDRE_vect, INSTR_TX)   // data register empty -> next byte
+{
+	if (!tx_left)                    // start of a new frame
+	{
+		if (tx_head == tx_tail && pend) flushPending(); // newest volume/track
+		if (tx_head == tx_tail)  // nothing left to send
+		{
+			hal_uart_tx_irq_off();
+			return;
+		}
+		tx_left = tx_pop();
+		tx_gap  = tx_pop();
+	}
+
+	hal_uart_put(tx_pop());          // load byte into register
+
+	if (--tx_left == 0 && tx_gap)    // frame finished, hold off the next one
+	{
+		hal_uart_tx_irq_off();
+		tx_pacing = 1;
+		hal_gap_start();         // Timer2 one-shot, 1 ms per compare match
+	}
+}
+
+INSTR_ISR(TIMER2_COMPA_vect, INSTR_GAP)   // 1 ms gap tick
+{
+	if (--tx_gap == 0)
+	{
+		hal_gap_stop();          // stop Timer2
+		tx_pacing = 0;
+		hal_uart_tx_irq_on();    // resume draining (ISR disables itself if empty)
+	}
+}
+
+// Writes one frame into the ring, 0 if it does not fit (interrupts off)
+static uint8_t txPush(const uint8_t *cmd, uint8_t len, uint8_t gap_ms)
+{
+	if (!len || mp3TxFree() < len + 2) return 0;
+	uint8_t h = tx_head;
+	tx_buf[h] = len;     h = (h + 1) & MP3_TX_MASK;
+	tx_buf[h] = gap_ms;  h = (h + 1) & MP3_TX_MASK;
+	for (uint8_t i = 0; i < len; i++)
+	{
+		tx_buf[h] = cmd[i];
+		h = (h + 1) & MP3_TX_MASK;
+	}
+	tx_head = h;                         // publish the whole frame at once
+	return 1;
+}
+
+// Frames for the pending volume and track, volume first so the track's
+// gain is in place when it starts. A 'v' goes out only if the level the
+// Trigger would end up at differs from the last one sent. Interrupts off.
+static void flushPending(void)
 {
-	while (!(UCSR0A & (1<<UDRE0)));	// Wait for transmit buffer to be empty
-	UDR0 = c;			// Load byte into register
-	while (!(UCSR0A & (1<<TXC0)));	// Wait for transmission to be finished
-	UCSR0A |= (1<<TXC0);		// Clear TX complete flag
-	_delay_ms(3);			// Short delay
+	int8_t gain = cur_gain;
+	if (pend & PEND_TRACK)
+	{
+		int16_t i = catalog_find(pend_track);
+		gain = (i < 0) ? 0 : catalog_gain(i);
+	}
+	int16_t a = (int16_t)vol_master - gain;
+	uint8_t att = (a < 0) ? 0 : (a > 255) ? 255 : a;
+	if (att != vol_sent)
+	{
+		uint8_t cmd[2] = { 'v', att };
+		if (!txPush(cmd, 2, MP3_CMD_GAP_MS)) return;
+		vol_sent = att;
+	}
+	pend &= ~PEND_VOL;
+
+	if (pend & PEND_STOP)
+	{
+		if (trig == TRIG_PLAYING && !(pend & PEND_TRACK))   // a pick stops the old track itself
+		{
+			uint8_t o = 'O';
+			if (!txPush(&o, 1, MP3_CMD_GAP_MS)) return;
+			trig = TRIG_IDLE;
+		}
+		pend &= ~PEND_STOP;
+	}
+
+	if (pend & PEND_TRACK)
+	{
+		// Both the if and else are used to play the selected numbered track
+		uint8_t t = pend_track;
+		uint8_t cmd[2];
+		if (t <= 9)                      // ASCII 'T' + digit 1-9
+		{
+			cmd[0] = 'T';		// Send T to play track 1-9
+			cmd[1] = t + '0';	// Convert digit to ASCII
+		}
+		else                            // binary trigger for 10-255
+		{
+			cmd[0] = 't';		// Send t for extended range
+			cmd[1] = t;             // Send binary track number
+		}
+		if (!txPush(cmd, 2, MP3_CMD_GAP_MS)) return;
+		trig = TRIG_PLAYING;
+		cur_gain = gain;
+		pend &= ~PEND_TRACK;
+	}
+}
+
+// Queues one command without blocking. Returns 0 if the ring is too full.
+// Pending volume/track values go first, so commands keep the order they were asked in.
+uint8_t mp3SendCommand(const uint8_t *cmd, uint8_t len, uint8_t gap_ms)
+{
+	uint8_t ok;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (pend) flushPending();
+		ok = txPush(cmd, len, gap_ms);
+		if (ok && !tx_pacing) hal_uart_tx_irq_on();
+	}
+	return ok;
+}
+
+// Sets the master attenuation (0 = loudest); only the newest value is sent
+void mp3SetVolume(uint8_t att)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		vol_master = att;
+		pend |= PEND_VOL;
+		if (!tx_pacing) hal_uart_tx_irq_on();
+	}
+}
+
+uint8_t mp3Volume(void)
+{
+	return vol_master;
+}
+
+// Free bytes in the TX ring (one slot is kept empty to tell full from empty)
+uint8_t mp3TxFree(void)
+{
+	return (uint8_t)(tx_tail - tx_head - 1) & MP3_TX_MASK;
+}
+
+// 1 when every queued command has gone out and no gap is pending
+uint8_t mp3TxIdle(void)
+{
+	return tx_head == tx_tail && !tx_left && !tx_pacing && !pend;
+}
+
+// Queues a one-byte command with the default pacing gap
+static void mp3SendByte(uint8_t c)
+{
+	mp3SendCommand(&c, 1, MP3_CMD_GAP_MS);
 }
 
 // Initializes USART0 for communication with the MP3 Trigger
 void mp3Init(uint32_t baud)
 {
 	uint16_t ubrr = MP3_SERIAL_UBRR(baud);	// Compute Baud rate
-	UBRR0H = ubrr >> 8;			// set high byte
-	UBRR0L = ubrr & 0xFF;			// set low byte
-	UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (1 << RXCIE0);;     // TX + RX + interrupt
-	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);	// Set 8-bit data format
-	_delay_ms(100);                      // let Trigger finish boot
+	hal_uart_init(ubrr, 1);			// 8N1, TX + RX + RX interrupt
+	hal_gap_init();				// Timer2 as the 1 ms command-gap tick
+	hal_busy_init(MP3_BUSY_PIN_IRQ);	// BUSY pin (PB2) input, pin-change if enabled
+	query_timer = MP3_QUERY_MS;
 
-	// Guaranteed STOP: two toggles = pause, then resume?toggle leaves idle
-	usartSendByte('O');  _delay_ms(10);   // pause if playing
-	usartSendByte('O');  _delay_ms(10);    // resume?toggle -> stopped
+	// Let Trigger finish boot without blocking: the gap timer holds the TX
+	// ring for MP3_BOOT_MS, and whatever is queued meanwhile goes out after
+	tx_gap    = MP3_BOOT_MS;
+	tx_pacing = 1;
+	hal_gap_start();
+
+	// Guaranteed STOP without toggling blind: a cold Trigger is idle, but one
+	// that kept its power through an MCU reset may still play. One 'Q' tells
+	// which, and the RX ISR stops it only then (queued here, sent once it is up)
+	trig = TRIG_UNKNOWN;
+	mp3SendByte('Q');
 }
 
-// Sends O to stop/start playback
-void mp3Stop(void) {
-	usartSendByte('O');
+// Stops playback. Nothing is sent if the Trigger is idle, and a pick not
+// sent yet is dropped instead of being sent and then stopped. The 'O' is
+// only pending: the UDRE ISR sends it once the ring drains if a frame is
+// going out, mp3SendCommand() before its own command, or else mp3Service()
+// starts the ISR. A pick that gets in first (shuffle, the paid queue in the
+// same pass) replaces it.
+// A stop is a stop, not a skip: the paid queue holds until the next pick
+// and the STOPPED event carries MP3_EVT_HALTED, so shuffle does not advance.
+void mp3Stop(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		pend = (pend & ~PEND_TRACK) | PEND_STOP;
+		holdoff = MP3_PLAY_HOLDOFF_MS;      // a reply to an earlier 'Q' is stale
+		halted = 1;
+		setStopped(MP3_EVT_HALTED);
+	}
 }
 
-// Plays a specific track on the MP3
+// Requests one track and marks it playing (main or ISR context). The
+// trigger itself is coalesced: a newer request before it goes out replaces it.
+// A trigger while a track plays makes the Trigger cancel it ('x') and start
+// the new one straight away, so no stop command or settle time is needed.
+static void startTrack(uint8_t track)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		pend_track = track;
+		pend |= PEND_TRACK;                 // with its catalog gain, see flushPending()
+		halted = 0;
+		if (!tx_pacing) hal_uart_tx_irq_on();
+		state.playing = 1;                  // optimistic until the Trigger says otherwise
+		state.track = track;
+		holdoff = MP3_PLAY_HOLDOFF_MS;      // replies for the old track are stale
+		query_timer = MP3_QUERY_MS;
+	}
+}
+
+// Starts the oldest queued track, 0 if the queue is empty (callers hold interrupts off)
+static uint8_t startNext(void)
+{
+	if (!pq_count) return 0;
+	uint8_t track = play_q[pq_head];
+	pq_head = (pq_head + 1) & MP3_QUEUE_MASK;
+	pq_count--;
+	startTrack(track);
+	evq_post(EVT_MP3, MP3_EVT_STARTED);
+	return 1;
+}
+
+// Plays a specific track on the MP3 right now
 void mp3PlayTrack(uint8_t track)
 {
-	if (track < 1 || track > TOTAL_SONGS) return;	// Checks if it is an invalid track number
+	if (track < 1) return;				// Checks if it is an invalid track number (1-255)
+	startTrack(track);
+}
 
-	mp3Stop();                              // Ensure the current playback is stopped
-	_delay_ms(20);				// Short delay for harware to work
+// Plays track now if the Trigger is idle, otherwise lines it up behind the queue
+uint8_t mp3Queue(uint8_t track)
+{
+	if (track < 1) return MP3_QUEUE_FULL;
 
-	// Both the if and else are used to play the selected numbered track
-	if (track <= 9)                          // ASCII T + digit 1-9
+	uint8_t pos = MP3_QUEUE_FULL;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		usartSendByte('T');		// Send T to play track 1-9
-		usartSendByte(track + '0');	// Convert digit to ASCII
+		if (!state.playing && !pq_count)
+		{
+			startTrack(track);
+			pos = 0;
+		}
+		else if (pq_count < MP3_QUEUE_LEN)
+		{
+			play_q[(pq_head + pq_count) & MP3_QUEUE_MASK] = track;
+			pos = ++pq_count;
+			if (halted && !state.playing && startNext()) pos--;   // a pick after a stop resumes the queue
+		}
 	}
-	else                                    // binary trigger for 10-255
+	return pos;
+}
+
+uint8_t mp3QueueLen(void)
+{
+	return pq_count;
+}
+
+uint8_t mp3QueueFind(uint8_t track)
+{
+	uint8_t pos = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		usartSendByte('t');		// Send t for extended range
-		usartSendByte(track);           // Send binary track number
+		for (uint8_t i = 0; i < pq_count; i++)
+		{
+			if (play_q[(pq_head + i) & MP3_QUEUE_MASK] == track) { pos = i + 1; break; }
+		}
 	}
+	return pos;
 }
 
-// Checks to see if the MP3 is playing audio
+// Checks to see if the MP3 is playing audio (cached, no UART traffic)
 uint8_t mp3IsBusy(void)
 {
-	usartSendByte('Q');          // Sends status query
-	_delay_ms(3);                // delay for response
-	
-	if(!(UCSR0A & (1 << RXC0)))  // If no response recieved
-	return 0;		 // Assumes that is is not playing
-	
-	uint8_t resp = UDR0;         // Read response byte 0 = idle, 1 = playing       */
-	return resp == 1;
-	}
\ No newline at end of file
+	return state.playing;
+}
+
+// Copy of the cached state for display/debug
+mp3State_t mp3GetState(void)
+{
+	mp3State_t s;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		s = state;
+	}
+	return s;
+}
+
+// Called from the 1 ms system tick: runs the query schedule
+void mp3Tick(void)
+{
+	if (holdoff) holdoff--;
+	if (query_timer && --query_timer == 0) query_due = 1;
+}
+
+// Called from the main loop: sends a status query when one is due, and
+// starts the queue after a stop or error (a normal 'X' is handled in the ISR)
+void mp3Service(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (!state.playing && !halted) startNext();
+		if (pend && !tx_pacing) hal_uart_tx_irq_on();   // a stop left by mp3Stop()
+	}
+	if (!query_due) return;
+	query_due = 0;
+
+	uint8_t send;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		send = state.playing && !holdoff;    // idle Trigger never starts on its own
+		query_timer = MP3_QUERY_MS;
+	}
+	if (send) mp3SendByte('Q');
+}
+
+// Marks the Trigger stopped and flags the falling edge for main
+static void setStopped(uint8_t ev)
+{
+	if (!state.playing) ev &= ~MP3_EVT_HALTED;   // only qualifies a STOPPED edge
+	if (state.playing) ev |= MP3_EVT_STOPPED;
+	state.playing = 0;
+	if (ev) evq_post(EVT_MP3, ev);
+}
+
+INSTR_ISR(USART_RX_vect, INSTR_RX)   // executes when a byte arrives on UART0
+{
+	uint8_t c = hal_uart_get();      // Read byte and clear RX flag
+	state.last_rx = c;
+
+	switch (c)
+	{
+	case 'X':                        // track finished
+		if (holdoff) break;
+		trig = TRIG_IDLE;
+		if (!pq_count || halted) { setStopped(MP3_EVT_FINISHED); break; }
+		evq_post(EVT_MP3, MP3_EVT_FINISHED);
+		startNext();                 // next paid selection goes out right now
+		break;
+	case 'x':                        // cancelled by a new command
+		evq_post(EVT_MP3, MP3_EVT_CANCELLED);
+		break;
+	case 'E':                        // track number error
+		state.errors++;
+		trig = TRIG_IDLE;
+		setStopped(MP3_EVT_ERROR);
+		break;
+	case 0:                          // 'Q' reply: idle
+		if (holdoff) break;
+		trig = TRIG_IDLE;
+		if (!MP3_BUSY_PIN_IRQ) setStopped(0);
+		break;
+	case 1:                          // 'Q' reply: playing
+		if (trig == TRIG_UNKNOWN)    // power-up query: still playing from before the reset
+		{
+			trig = TRIG_PLAYING;
+			pend |= PEND_STOP;
+			if (!tx_pacing) hal_uart_tx_irq_on();
+			break;
+		}
+		if (holdoff) break;
+		trig = TRIG_PLAYING;
+		if (!MP3_BUSY_PIN_IRQ) state.playing = 1;
+		break;
+	}
+}
+
+#if MP3_BUSY_PIN_IRQ
+INSTR_ISR(PCINT0_vect, INSTR_BUSY)   // BUSY line (PB2) changed
+{
+	if (hal_busy_idle())             // high = idle
+	{
+		if (!holdoff) { trig = TRIG_IDLE; setStopped(0); }
+	}
+	else if (trig != TRIG_UNKNOWN)   // at power-up the 'Q' reply decides
+	{
+		trig = TRIG_PLAYING;
+		state.playing = 1;
+	}
+}
+#endif
@@ -5,11 +5,46 @@
 #include "jukebox_config.h"
 
 void mp3Init(uint32_t baud);
-void mp3PlayTrack(uint8_t track);   // 1TOTAL_SONGS            
+void mp3PlayTrack(uint8_t track);   // SD card track 1-255, cuts off the current one
 void mp3Next(void);                 // skip forward             
 void mp3Toggle(void);               // play/pause toggle        
-void mp3Stop(void);                 // explicit stop            
-uint8_t mp3IsBusy(void);            // BUSY line (PB2 == 0)     
+void mp3Stop(void);                 // explicit stop, sent only if the Trigger plays
+uint8_t mp3IsBusy(void);            // cached play state, O(1)
+void mp3SetVolume(uint8_t att);     // attenuation 0 (loudest)-255, coalesced; catalog gain added per track
+uint8_t mp3Volume(void);
+
+// Cached Trigger state, kept by the RX parser (and BUSY pin when enabled).
+// Each reply is also posted to the event ring (evq.h) as one EVT_MP3 whose
+// data holds the MP3_EVT_* bits below, so two finishes are two events.
+#define MP3_EVT_FINISHED  0x01      // 'X' track finished
+#define MP3_EVT_CANCELLED 0x02      // 'x' track cancelled by a new command
+#define MP3_EVT_ERROR     0x04      // 'E' track number error
+#define MP3_EVT_STOPPED   0x08      // playing -> idle edge (any cause)
+#define MP3_EVT_STARTED   0x10      // a queued track was started (see state.track)
+#define MP3_EVT_HALTED    0x20      // with STOPPED: mp3Stop(), nothing starts on its own
+
+typedef struct {
+	uint8_t playing;                // 1 while a track is playing
+	uint8_t last_rx;                // last byte received from the Trigger
+	uint8_t errors;                 // 'E' replies since boot
+	uint8_t track;                  // last track started
+} mp3State_t;
+
+mp3State_t mp3GetState(void);       // snapshot of the cached state
+void mp3Tick(void);                 // call every 1 ms from the timer ISR
+void mp3Service(void);              // call from main loop, sends scheduled 'Q'
+
+// Play queue: paid selections wait for the current track to finish, and the
+// next one is sent from the RX ISR as soon as the Trigger reports 'X'
+#define MP3_QUEUE_FULL 0xFF
+uint8_t mp3Queue(uint8_t track);    // 0 = playing now, 1..N = queue position, MP3_QUEUE_FULL
+uint8_t mp3QueueLen(void);          // tracks waiting
+uint8_t mp3QueueFind(uint8_t track);// queue position 1..N of track, 0 if not queued
+
+// Non-blocking TX queue (drained by USART_UDRE, paced by Timer2)
+uint8_t mp3SendCommand(const uint8_t *cmd, uint8_t len, uint8_t gap_ms); // 0 if queue full
+uint8_t mp3TxFree(void);            // free bytes in the TX ring
+uint8_t mp3TxIdle(void);            // 1 when nothing is queued, pending or pacing
 
 
 #endif
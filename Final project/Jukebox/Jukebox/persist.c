@@ -0,0 +1,105 @@
+// persist.c  wear-leveled EEPROM journal for credits, modes and the selected song
+
+#include <avr/eeprom.h>      // eeprom_read_byte, eeprom_write_byte
+#include <util/crc16.h>      // _crc8_ccitt_update
+#include <string.h>          // memcmp
+#include "persist.h"         // Header file
+#include "tick.h"            // batching and rate limit
+
+// One slot: [seq lo][seq hi][credits][card][flags][song][0][crc8 of bytes 0-6]
+#define REC_LEN 8
+
+typedef struct {
+	uint16_t seq;
+	persistState_t st;
+	uint8_t  rsvd;
+	uint8_t  crc;
+} record_t;
+typedef char record_size_ok[sizeof(record_t) == REC_LEN ? 1 : -1];
+
+static persistState_t want;          // latest state handed to persist_save()
+static record_t rec;                 // record being written
+static uint16_t seq;                 // sequence number of the newest record
+static uint8_t  slot;                // slot the next record goes to
+static uint8_t  dirty = 0;           // want differs from the EEPROM
+static uint8_t  wr    = REC_LEN;     // next byte of rec to write, REC_LEN = idle
+static tick_t   due, last_write;
+static uint16_t records = 0;
+
+static uint8_t crc8(const uint8_t *p, uint8_t n)
+{
+	uint8_t c = 0;
+	while (n--) c = _crc8_ccitt_update(c, *p++);
+	return c;
+}
+
+static uint8_t *slot_addr(uint8_t i)
+{
+	return (uint8_t *)(uintptr_t)(PERSIST_ADDR + i * REC_LEN);
+}
+
+// Reads all PERSIST_SLOTS slots once (128 bytes), whatever is in them
+uint8_t persist_load(persistState_t *s)
+{
+	uint8_t found = 0;
+	record_t r;
+
+	for (uint8_t i = 0; i < PERSIST_SLOTS; i++)
+	{
+		uint8_t *src = slot_addr(i), *dst = (uint8_t *)&r;
+		for (uint8_t b = 0; b < REC_LEN; b++) dst[b] = eeprom_read_byte(src + b);
+		if (r.crc != crc8(dst, REC_LEN - 1)) continue;   // torn, or blank: 7 x 0xFF has CRC 0x0C
+
+		if (!found || (int16_t)(r.seq - seq) > 0)      // newest, wrap-safe
+		{
+			seq   = r.seq;
+			slot  = (i + 1) % PERSIST_SLOTS;
+			*s    = r.st;
+			found = 1;
+		}
+	}
+	if (found) want = *s;
+	last_write = tick_now();
+	return found;
+}
+
+void persist_save(const persistState_t *s)
+{
+	if (!memcmp(s, &want, sizeof(want))) return;
+	want = *s;
+	if (dirty) return;                          // joins the batch already waiting
+	dirty = 1;
+	due = tick_deadline(PERSIST_BATCH_MS);
+	if ((int32_t)(last_write + PERSIST_MIN_MS - due) > 0) due = last_write + PERSIST_MIN_MS;
+}
+
+// A byte write takes 3.4 ms in the background; one per call keeps every
+// call short instead of blocking ~27 ms for a whole record
+void persist_task(void)
+{
+	if (wr < REC_LEN)
+	{
+		if (!eeprom_is_ready()) return;
+		eeprom_write_byte(slot_addr(slot) + wr, ((uint8_t *)&rec)[wr]);
+		if (++wr == REC_LEN)
+		{
+			slot = (slot + 1) % PERSIST_SLOTS;
+			records++;
+		}
+		return;
+	}
+	if (!dirty || !tick_expired(due)) return;
+
+	dirty    = 0;
+	rec.seq  = ++seq;
+	rec.st   = want;
+	rec.rsvd = 0;
+	rec.crc  = crc8((const uint8_t *)&rec, REC_LEN - 1);
+	wr = 0;
+	last_write = tick_now();
+}
+
+uint16_t persist_records(void)
+{
+	return records;
+}
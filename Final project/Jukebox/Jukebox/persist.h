@@ -0,0 +1,27 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Jukebox state journaled to a wear-leveled EEPROM ring. Each save goes
+// to the slot after the newest one, stamped with a sequence number and a
+// CRC-8, so a record torn by a brown-out is skipped at the next boot.
+
+#define PERSIST_ADMIN   0x01        // flags
+#define PERSIST_SHUFFLE 0x02
+#define PERSIST_POPULAR 0x04            // knob browses by popularity (plays.h)
+
+typedef struct {
+	uint8_t credits;
+	uint8_t card;                   // card table slot paying, 0xFF = none
+	uint8_t flags;                  // PERSIST_*
+	uint8_t song;                   // selected song, 0xFF = none
+} persistState_t;
+
+uint8_t  persist_load(persistState_t *s); // boot: newest valid record, 0 = none (blank EEPROM)
+void     persist_save(const persistState_t *s); // cheap when unchanged, written later in a batch
+void     persist_task(void);              // every 10 ms: at most one EEPROM byte per call
+uint16_t persist_records(void);           // records committed since boot
+
+#endif
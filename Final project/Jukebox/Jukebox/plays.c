@@ -0,0 +1,118 @@
+// plays.c  per-track pick counts and the popularity browse order
+
+#include <avr/eeprom.h>      // eeprom_read_byte, eeprom_write_byte
+#include "plays.h"           // Header file
+#include "catalog.h"         // catalog_track() for the EEPROM address
+#include "tick.h"            // flush batching
+
+// [magic][count of track 1]...[count of track 255]. Each count is one
+// byte, so an ordinary flush cut short by a reset only loses the picks
+// not written yet. The two passes that must land whole, the first zeroing
+// and the halving, run with the magic cleared and rewrite it at the end:
+// a reset during them starts the table over at zero.
+#define PLAYS_MAGIC 0x5A
+#define DIRTY_LEN   ((TOTAL_SONGS + 7) / 8)
+
+static uint8_t count[TOTAL_SONGS];   // per catalog index
+static uint8_t order[TOTAL_SONGS];   // catalog indexes, most picked first
+static uint8_t dirty[DIRTY_LEN];     // counts not in the EEPROM yet
+static uint8_t ndirty = 0;
+static uint8_t magic_ok = 0;         // EEPROM table initialised
+static uint8_t whole = 0;            // the batch must land whole (halving)
+static uint8_t next = 0;             // flush scan position
+static tick_t  due;
+
+static uint8_t *count_addr(uint8_t idx)
+{
+	return (uint8_t *)(uintptr_t)(PLAYS_ADDR + catalog_track(idx));
+}
+
+static void mark(uint8_t idx)
+{
+	uint8_t bit = 1 << (idx & 7);
+	if (dirty[idx >> 3] & bit) return;
+	dirty[idx >> 3] |= bit;
+	if (!ndirty++) due = tick_deadline(PLAYS_FLUSH_MS);   // first of a batch
+}
+
+static void swap(uint8_t r)          // order[r] and order[r - 1]
+{
+	uint8_t a = order[r];
+	order[r] = order[r - 1]; order[r - 1] = a;
+}
+
+void plays_init(void)
+{
+	magic_ok = eeprom_read_byte((uint8_t *)PLAYS_ADDR) == PLAYS_MAGIC;
+	for (uint8_t i = 0; i < TOTAL_SONGS; i++)
+	{
+		count[i] = magic_ok ? eeprom_read_byte(count_addr(i)) : 0;
+		if (!magic_ok) mark(i);      // blank or torn: write zeros before the magic
+
+		// Insertion sort, once per boot; ties keep the catalog order
+		uint8_t r = i;
+		order[r] = i;
+		while (r && count[order[r - 1]] < count[i]) swap(r--);
+	}
+}
+
+void plays_count(uint8_t idx)
+{
+	if (idx >= TOTAL_SONGS) return;
+	if (count[idx] == 0xFF)          // age everything; halving keeps the order sorted
+	{
+		for (uint8_t i = 0; i < TOTAL_SONGS; i++) { count[i] >>= 1; mark(i); }
+		whole = 1;
+	}
+	count[idx]++;
+	mark(idx);
+
+	uint8_t r = plays_rank(idx);     // bubble up past the tracks it now beats
+	while (r && count[order[r - 1]] < count[idx]) swap(r--);
+}
+
+uint8_t plays_get(uint8_t idx)
+{
+	return count[idx];
+}
+
+uint8_t plays_ranked(uint8_t r)
+{
+	return order[r];
+}
+
+// A scan, not an inverse table: TOTAL_SONGS bytes of RAM saved for a
+// few microseconds per knob detent or pick
+uint8_t plays_rank(uint8_t idx)
+{
+	uint8_t r = 0;
+	while (r < TOTAL_SONGS - 1 && order[r] != idx) r++;
+	return r;
+}
+
+// Same pacing as persist_task(): one background byte write per call, and
+// only bytes whose value changed are written
+void plays_task(void)
+{
+	if ((!ndirty && magic_ok) || !eeprom_is_ready()) return;
+	if (ndirty && !tick_expired(due)) return;
+
+	if (!ndirty)                     // every count is out, now the table is valid
+	{
+		eeprom_write_byte((uint8_t *)PLAYS_ADDR, PLAYS_MAGIC);
+		magic_ok = 1;
+		whole = 0;
+		return;
+	}
+	if (whole && magic_ok)           // invalid until the whole halving is out
+	{
+		eeprom_write_byte((uint8_t *)PLAYS_ADDR, 0);
+		magic_ok = 0;
+		return;
+	}
+	while (!(dirty[next >> 3] & (1 << (next & 7)))) next = (next + 1) % TOTAL_SONGS;
+	dirty[next >> 3] &= ~(1 << (next & 7));
+	ndirty--;
+	uint8_t *p = count_addr(next);
+	if (eeprom_read_byte(p) != count[next]) eeprom_write_byte(p, count[next]);
+}
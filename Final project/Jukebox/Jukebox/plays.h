@@ -0,0 +1,26 @@
+#ifndef PLAYS_H
+#define PLAYS_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Per-track pick counts and a popularity order of the catalog. Counts are
+// one byte per track in RAM, mirrored at PLAYS_ADDR + SD track number, so
+// they survive catalog rebuilds. A pick marks its byte dirty; the dirty
+// bytes go to the EEPROM together, PLAYS_FLUSH_MS after the first one.
+// When a count would pass 255, all counts are halved: the order holds
+// and old favourites slowly make room for new ones. A reset in the middle
+// of writing a halving restarts the table at zero (see plays.c).
+//
+// The order is kept sorted (most picks first) by moving the picked entry
+// up past the ones it now beats, usually one swap, never a full sort.
+// RAM: two bytes and a dirty bit per track (550 bytes at 255 tracks).
+
+void    plays_init(void);                  // boot: counts from the EEPROM, builds the order
+void    plays_count(uint8_t idx);          // one pick of catalog index idx
+uint8_t plays_get(uint8_t idx);            // picks of catalog index idx (aged)
+uint8_t plays_ranked(uint8_t rank);        // catalog index at rank (0 = most picked)
+uint8_t plays_rank(uint8_t idx);           // rank of catalog index idx, a scan of the order
+void    plays_task(void);                  // every 10 ms: at most one EEPROM byte per call
+
+#endif
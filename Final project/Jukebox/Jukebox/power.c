@@ -0,0 +1,60 @@
+// power.c  idle detection, RFID beacon rate and amplifier standby
+
+#include "hal.h"             // amplifier pin, PRR
+#include "power.h"           // Header file
+#include "tick.h"            // tick_now()
+#include "rfid.h"            // rfid_poll_period()
+#include "mp3.h"             // mp3IsBusy()
+
+static tick_t  last_input;           // last knob, button or card
+static tick_t  quiet_since;          // last time a track was playing
+static uint8_t amp_on = 0;
+static uint8_t idle   = 0;
+
+void power_init(void)
+{
+	hal_power_init();
+	hal_amp_init();              // amplifier starts in standby
+	last_input = quiet_since = tick_now();
+}
+
+void power_activity(void)
+{
+	last_input = tick_now();
+	if (idle)
+	{
+		idle = 0;
+		rfid_poll_period(RFID_POLL_MS);  // next tick polls right away
+	}
+}
+
+void power_amp_on(void)
+{
+	quiet_since = tick_now();
+	if (!amp_on) { hal_amp(1); amp_on = 1; }
+}
+
+void power_task(void)
+{
+	if (mp3IsBusy())
+	{
+		power_amp_on();              // also covers tracks started from the RX ISR
+		return;                      // someone paid for this, keep the reader fast
+	}
+	if (amp_on && tick_elapsed(quiet_since) >= POWER_AMP_OFF_MS)
+	{
+		hal_amp(0);                  // gap long enough that it is not between tracks
+		amp_on = 0;
+	}
+	if (!idle && tick_elapsed(last_input) >= POWER_IDLE_MS &&
+	    tick_elapsed(quiet_since) >= POWER_IDLE_MS)
+	{
+		idle = 1;
+		rfid_poll_period(RFID_BEACON_MS);
+	}
+}
+
+uint8_t power_idle(void)
+{
+	return idle;
+}
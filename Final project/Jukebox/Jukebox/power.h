@@ -0,0 +1,18 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Idle power manager. The main loop always sleeps between interrupts
+// (hal_idle); on top of that, after POWER_IDLE_MS with no input and no
+// music the reader drops to a slow beacon, and the STA540 goes to
+// standby POWER_AMP_OFF_MS after the last track ends.
+
+void    power_init(void);           // amplifier pin, unused peripherals off
+void    power_activity(void);       // knob, button or card: back to full rate
+void    power_amp_on(void);         // call right before starting a track
+void    power_task(void);           // every 100 ms from the scheduler
+uint8_t power_idle(void);           // 1 while in the beacon state
+
+#endif
@@ -0,0 +1,80 @@
+// rfid.c scheduled ID-12LA poller with a recently-seen UID cache
+
+#include "jukebox_config.h"  // Includes code from jukebox_config.h
+#include <string.h>          // memcmp, memcpy
+#include "twi.h"             // interrupt-driven TWI engine
+#include "tick.h"            // 1 ms timebase
+#include "rfid.h"            // Header file
+
+// ---------- Poll transfer (SLA+R, 6 bytes), submitted from rfid_tick()
+static uint8_t   rfid_buf[MAX_UID_LEN];
+static twiXfer_t rfid_xfer = {
+	.addr = RFID_ADDR, .rlen = MAX_UID_LEN, .rbuf = rfid_buf,
+	.timeout_ms = RFID_TIMEOUT_MS,
+};
+
+static uint8_t poll_timer = 0;            // ms since the last poll
+static volatile uint8_t poll_ms = RFID_POLL_MS;  // poll period, slower while idle
+
+// ---------- Recently seen cards
+// A card resting on the reader keeps refreshing its entry, so it is only
+// reported once; it counts again after RFID_HOLD_MS away from the reader.
+typedef struct {
+	char     uid[MAX_UID_LEN];
+	tick_t   seen;                    // tick_now() of the last read
+} rfidSeen_t;
+
+static rfidSeen_t cache[RFID_CACHE_LEN];
+
+void rfid_tick(void)
+{
+	if (++poll_timer < poll_ms) return;
+	poll_timer = 0;
+
+	uint8_t st = rfid_xfer.status;
+	if (st != TWI_PENDING && st != TWI_OK)   // bus free and last result taken
+	{
+		twi_submit(&rfid_xfer);
+	}
+}
+
+// 1 if uid was read within RFID_HOLD_MS; records the read either way
+static uint8_t seenRecently(const char *uid)
+{
+	tick_t now = tick_now();
+
+	uint8_t oldest = 0;
+	for (uint8_t i = 0; i < RFID_CACHE_LEN; i++)
+	{
+		if (!memcmp(cache[i].uid, uid, MAX_UID_LEN))
+		{
+			tick_t age = now - cache[i].seen;
+			cache[i].seen = now;
+			return age < RFID_HOLD_MS;
+		}
+		if (now - cache[i].seen > now - cache[oldest].seen) oldest = i;
+	}
+
+	memcpy(cache[oldest].uid, uid, MAX_UID_LEN);   // new card replaces the stalest entry
+	cache[oldest].seen = now;
+	return 0;
+}
+
+uint8_t rfid_read_uid(char *uid)
+{
+	if (rfid_xfer.status != TWI_OK) return 0;      // nothing new from the poller
+
+	memcpy(uid, rfid_buf, MAX_UID_LEN);
+	rfid_xfer.status = TWI_IDLE;                   // buffer free for the next poll
+
+	uint8_t any = 0;
+	for (uint8_t i = 0; i < MAX_UID_LEN; i++) any |= uid[i];
+	if (!any) return 0;                            // reader answers zeros with no tag
+
+	return !seenRecently(uid);
+}
+
+void rfid_poll_period(uint8_t ms)
+{
+	poll_ms = ms;
+}
@@ -0,0 +1,12 @@
+#ifndef RFID_H
+#define RFID_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// ID-12LA Qwiic reader, polled over the TWI engine on a fixed schedule
+void    rfid_tick(void);            // call every 1 ms from the timer ISR
+uint8_t rfid_read_uid(char *uid);   // 1 = a card that was not already on the reader
+void    rfid_poll_period(uint8_t ms);  // RFID_POLL_MS, or RFID_BEACON_MS when idle
+
+#endif
@@ -0,0 +1,79 @@
+// sched.c cooperative timer-driven task scheduler
+
+#include "jukebox_config.h"  // Includes code from jukebox_config.h
+#include "tick.h"            // 1 ms timebase and us stamps
+#include "sched.h"           // Header file
+
+typedef struct {
+	schedFn_t fn;                // NULL = free slot
+	uint16_t  period;            // ticks between runs, 0 = one-shot
+	uint16_t  due;               // tick count of the next run
+	uint16_t  worst;             // longest run so far, us
+} schedTask_t;
+
+static schedTask_t tasks[SCHED_MAX_TASKS];
+static uint16_t worst_all = 0;        // us
+static uint16_t overruns  = 0;
+
+static uint16_t ticksNow(void) { return (uint16_t)tick_now(); } // low half is enough for due times
+
+static uint8_t add(schedFn_t fn, uint16_t period, uint16_t delay)
+{
+	for (uint8_t i = 0; i < SCHED_MAX_TASKS; i++)
+	{
+		if (tasks[i].fn) continue;
+		tasks[i].period = period;
+		tasks[i].due    = ticksNow() + delay;
+		tasks[i].worst  = 0;
+		tasks[i].fn     = fn;
+		return i;
+	}
+	return SCHED_NONE;                         // table full
+}
+
+uint8_t sched_every(schedFn_t fn, uint16_t period) { return add(fn, period, period); }
+
+uint8_t sched_after(schedFn_t fn, uint16_t delay)  { return add(fn, 0, delay); }
+
+void sched_cancel(uint8_t id)
+{
+	if (id < SCHED_MAX_TASKS) tasks[id].fn = 0;
+}
+
+void sched_run(void)
+{
+	for (uint8_t i = 0; i < SCHED_MAX_TASKS; i++)
+	{
+		schedTask_t *t = &tasks[i];
+		uint16_t now = ticksNow();
+		if (!t->fn || (int16_t)(now - t->due) < 0) continue;
+
+		schedFn_t fn = t->fn;
+		if (t->period)                           // next slot, without drifting
+		{
+			t->due += t->period;
+			if ((int16_t)(now - t->due) >= 0) t->due = now + t->period; // fell behind, skip
+		}
+		else
+		{
+			t->fn = 0;                       // one-shot: slot free before it runs
+		}
+
+		uint16_t t0 = tick_stamp_us();
+		fn();
+		uint16_t dt = tick_stamp_us() - t0;
+
+		if (t->fn == fn && dt > t->worst) t->worst = dt;
+		if (dt > worst_all) worst_all = dt;
+		if (dt > SCHED_BUDGET_US) overruns++;
+	}
+}
+
+uint32_t sched_worst_us(uint8_t id)
+{
+	return (id < SCHED_MAX_TASKS) ? tasks[id].worst : 0;
+}
+
+uint32_t sched_worst_all_us(void) { return worst_all; }
+
+uint16_t sched_overruns(void) { return overruns; }
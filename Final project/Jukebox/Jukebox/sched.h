@@ -0,0 +1,24 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Run-to-completion scheduler: tasks are plain functions that must return
+// quickly (no _delay_ms). sched_run() is called from main's while(1).
+// Times are in ms on the tick.c timebase.
+typedef void (*schedFn_t)(void);
+
+#define SCHED_NONE 0xFF                               // "no task" id
+
+uint8_t  sched_every(schedFn_t fn, uint16_t period);  // periodic task, returns id
+uint8_t  sched_after(schedFn_t fn, uint16_t delay);   // one-shot task, returns id
+void     sched_cancel(uint8_t id);                    // SCHED_NONE is ignored
+void     sched_run(void);                             // runs every task that is due
+
+// Latency report, run time measured with tick_stamp_us() (4 us steps, up to 65 ms)
+uint32_t sched_worst_us(uint8_t id);                  // longest single run of one task
+uint32_t sched_worst_all_us(void);                    // longest run of any task
+uint16_t sched_overruns(void);                        // runs longer than SCHED_BUDGET_US
+
+#endif
@@ -0,0 +1,72 @@
+// shuffle.c  Fisher-Yates play order for shuffle mode
+
+#include "hal.h"             // ADC noise source
+#include "shuffle.h"         // Header file
+
+static uint8_t  order[TOTAL_SONGS];    // current permutation of catalog indexes
+static uint8_t  pos;                   // next slot to play
+static uint8_t  last;                  // index played last
+static uint8_t  redraw;                // 1 from the second cycle on: draw while playing
+static uint32_t rng;                   // xorshift32 state, never 0
+
+static uint16_t rnd16(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng >> 16;
+}
+
+// Uniform pick in [0, n) by multiply-shift, no 32-bit divide on the AVR
+static uint8_t rnd_below(uint8_t n)
+{
+	return ((uint32_t)rnd16() * n) >> 16;
+}
+
+// One Fisher-Yates step: fixes order[k] from the songs not yet drawn
+static void draw(uint8_t k)
+{
+	uint8_t j = k + rnd_below(TOTAL_SONGS - k);
+	uint8_t t = order[k]; order[k] = order[j]; order[j] = t;
+}
+
+// Folds noisy ADC LSBs (internal temperature sensor sampled far too fast)
+// and the Timer0 phase they finish at into 32 bits
+uint32_t shuffle_entropy(void)
+{
+	uint32_t s = 0;
+	hal_noise_init();
+	for (uint8_t i = 0; i < 64; i++)
+	{
+		s = (s << 5 | s >> 27) ^ hal_noise_sample() ^ ((uint16_t)hal_tick_count() << 10);
+	}
+	hal_noise_off();             // ADC back to power-down
+	return s;
+}
+
+void shuffle_init(uint32_t seed)
+{
+	rng = seed ? seed : 0x2545F491;
+	for (uint16_t i = 0; i < TOTAL_SONGS; i++) order[i] = i;
+	for (uint8_t k = 0; k + 1 < TOTAL_SONGS; k++) draw(k);   // whole first cycle up front
+	pos    = 0;
+	redraw = 0;
+}
+
+// Returns order[pos]. Later cycles are reshuffled one swap per pick, so no
+// call ever does more than a single Fisher-Yates step.
+uint8_t shuffle_next(void)
+{
+	if (pos == TOTAL_SONGS) { pos = 0; redraw = 1; }
+	if (redraw)
+	{
+		draw(pos);
+		if (pos == 0 && order[0] == last && TOTAL_SONGS > 1)
+		{
+			uint8_t j = 1 + rnd_below(TOTAL_SONGS - 1);  // no repeat across the seam
+			order[0] = order[j]; order[j] = last;
+		}
+	}
+	last = order[pos++];
+	return last;
+}
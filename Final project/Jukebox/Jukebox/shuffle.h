@@ -0,0 +1,15 @@
+#ifndef SHUFFLE_H
+#define SHUFFLE_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// Non-repeating shuffle: a Fisher-Yates permutation of the catalog, one
+// byte per song (TOTAL_SONGS <= 255). Every song plays once per cycle and
+// no song plays twice in a row across cycles.
+
+uint32_t shuffle_entropy(void);        // boot seed from ADC noise and timer jitter
+void     shuffle_init(uint32_t seed);  // precomputes the first cycle
+uint8_t  shuffle_next(void);           // next catalog index, O(1)
+
+#endif
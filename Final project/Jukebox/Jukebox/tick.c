@@ -0,0 +1,59 @@
+// tick.c 1 ms monotonic timebase and software timers
+
+#include "jukebox_config.h"  // Includes code from jukebox_config.h
+#include "hal.h"             // Timer0
+#include <util/atomic.h>     // ATOMIC_BLOCK for the 32-bit read
+#include "tick.h"            // Header file
+
+#define TICK_OCR 249         // 250 counts of 4 us = 1 ms
+
+static volatile tick_t ms = 0;   // only written by tick_advance()
+
+void tick_init(void)
+{
+	hal_tick_init(TICK_OCR);                 // CTC, prescaler 64 -> 4 us per count
+}
+
+void tick_advance(void)
+{
+	ms++;
+}
+
+tick_t tick_now(void)
+{
+	tick_t t;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)        // 4 byte loads must not straddle an ISR
+	{
+		t = ms;
+	}
+	return t;
+}
+
+uint16_t tick_stamp_us(void)
+{
+	uint16_t m;
+	uint8_t  c;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		m = (uint16_t)ms;
+		c = hal_tick_count();
+		if (hal_tick_pending() && c < TICK_OCR / 2) m++;  // match not serviced yet
+	}
+	return m * 1000u + (uint16_t)c * 4;
+}
+
+void tick_periodic_start(tickPeriodic_t *p, uint16_t period_ms)
+{
+	p->period = period_ms;
+	p->next   = tick_now() + period_ms;
+}
+
+uint8_t tick_periodic_due(tickPeriodic_t *p)
+{
+	tick_t now = tick_now();
+	if ((int32_t)(now - p->next) < 0) return 0;
+
+	p->next += p->period;
+	if ((int32_t)(now - p->next) >= 0) p->next = now + p->period; // fell behind, skip
+	return 1;
+}
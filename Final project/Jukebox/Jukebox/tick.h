@@ -0,0 +1,32 @@
+#ifndef TICK_H
+#define TICK_H
+
+#include <stdint.h>
+#include "jukebox_config.h"
+
+// 1 ms monotonic timebase on Timer0 (CTC). Never reset; wraps after ~49 days,
+// so always compare with differences, never with < on raw values.
+typedef uint32_t tick_t;
+
+void     tick_init(void);           // Timer0 CTC, 16MHz/64/250 = 1 kHz
+void     tick_advance(void);        // call first thing in ISR(TIMER0_COMPA_vect)
+tick_t   tick_now(void);            // ms since boot, atomic 32-bit read
+uint16_t tick_stamp_us(void);       // free-running us stamp (4 us steps, wraps at 65 ms)
+
+// Software timers built on tick_now()
+static inline tick_t  tick_elapsed(tick_t since)  { return tick_now() - since; }
+static inline tick_t  tick_deadline(uint32_t ms)  { return tick_now() + ms; }
+static inline uint8_t tick_expired(tick_t deadline)
+{
+	return (int32_t)(tick_now() - deadline) >= 0;
+}
+
+typedef struct {
+	tick_t   next;                  // deadline of the next period
+	uint16_t period;                // ms
+} tickPeriodic_t;
+
+void    tick_periodic_start(tickPeriodic_t *p, uint16_t period_ms);
+uint8_t tick_periodic_due(tickPeriodic_t *p);   // 1 once per period, no drift
+
+#endif
@@ -0,0 +1,183 @@
+// twi.c interrupt-driven TWI (I2C) master with per-transaction timeouts
+
+#include "twi.h"             // Header file (F_CPU default)
+#include "hal.h"             // TWI unit and bus pins
+#include <avr/interrupt.h>   // ISR() vector
+#include <util/atomic.h>     // ATOMIC_BLOCK for the queue indices
+#include <util/delay.h>      // bit-banged recovery clock
+#include <util/twi.h>        // TW_* status codes
+#include "instr.h"           // INSTR_ISR() (no-op outside the jukebox)
+
+#ifndef TWI_DEFAULT_TIMEOUT_MS
+#define TWI_DEFAULT_TIMEOUT_MS 10   // used when a transfer leaves timeout_ms at 0
+#endif
+
+#define TWI_QMASK (TWI_QUEUE_LEN - 1)
+#define TWI_GO    ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))  // continue, keep interrupt on
+
+static twiXfer_t * volatile queue[TWI_QUEUE_LEN];
+static volatile uint8_t q_head = 0;     // next free slot
+static volatile uint8_t q_tail = 0;     // transfer on the bus
+static volatile uint8_t active = 0;     // 1 while a transfer owns the bus
+static volatile uint8_t tmo    = 0;     // ms left for the active transfer
+static twiXfer_t *cur;                  // == queue[q_tail] while active
+static uint8_t idx;                     // byte index in the current phase
+static uint8_t reading;                 // 0 = write phase, 1 = read phase
+
+// Makes queue[q_tail] the current transfer (caller sends the START)
+static void loadNext(void)
+{
+	cur     = queue[q_tail];
+	idx     = 0;
+	reading = (cur->wlen == 0);
+	tmo     = cur->timeout_ms ? cur->timeout_ms : TWI_DEFAULT_TIMEOUT_MS;
+	active  = 1;
+}
+
+// Completes the current transfer and chains a START for the next one
+static void finish(uint8_t st)
+{
+	twiXfer_t *x = cur;
+	q_tail = (q_tail + 1) & TWI_QMASK;
+	x->status = st;
+	if (x->done) x->done(x);            // may submit another transfer
+
+	if (q_head != q_tail)
+	{
+		loadNext();
+		hal_twi_ctrl(TWI_GO | (1 << TWSTO) | (1 << TWSTA)); // STOP, then START
+	}
+	else
+	{
+		active = 0;
+		hal_twi_ctrl((1 << TWINT) | (1 << TWEN) | (1 << TWSTO)); // STOP, bus released
+	}
+}
+
+void twi_begin(uint8_t twbr)
+{
+	hal_twi_init(twbr);                    // prescaler 1
+}
+
+uint8_t twi_submit(twiXfer_t *x)
+{
+	uint8_t ok = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint8_t next = (q_head + 1) & TWI_QMASK;
+		if (next != q_tail)                // room in the queue
+		{
+			x->status = TWI_PENDING;
+			queue[q_head] = x;
+			q_head = next;
+			if (!active)               // bus idle, kick it off
+			{
+				loadNext();
+				hal_twi_ctrl(TWI_GO | (1 << TWSTA));
+			}
+			ok = 1;
+		}
+	}
+	return ok;
+}
+
+uint8_t twi_idle(void)
+{
+	return !active;
+}
+
+INSTR_ISR(TWI_vect, INSTR_TWI)
+{
+	twiXfer_t *x = cur;
+
+	switch (hal_twi_status())
+	{
+	case TW_START:
+	case TW_REP_START:
+		hal_twi_put((x->addr << 1) | (reading ? TW_READ : TW_WRITE));
+		hal_twi_ctrl(TWI_GO);
+		break;
+
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if (idx < x->wlen)                 // more to write
+		{
+			hal_twi_put(x->wbuf[idx++]);
+			hal_twi_ctrl(TWI_GO);
+		}
+		else if (x->rlen)                  // repeated START into the read phase
+		{
+			reading = 1;
+			idx = 0;
+			hal_twi_ctrl(TWI_GO | (1 << TWSTA));
+		}
+		else
+		{
+			finish(TWI_OK);
+		}
+		break;
+
+	case TW_MT_ARB_LOST:                       // same code for MR, start over
+		idx = 0;
+		reading = (x->wlen == 0);
+		hal_twi_ctrl(TWI_GO | (1 << TWSTA));
+		break;
+
+	case TW_MR_SLA_ACK:                        // ACK every byte except the last
+		hal_twi_ctrl(TWI_GO | (x->rlen > 1 ? (1 << TWEA) : 0));
+		break;
+
+	case TW_MR_DATA_ACK:
+		x->rbuf[idx++] = hal_twi_get();
+		hal_twi_ctrl(TWI_GO | (idx < x->rlen - 1 ? (1 << TWEA) : 0));
+		break;
+
+	case TW_MR_DATA_NACK:                      // last byte
+		x->rbuf[idx] = hal_twi_get();
+		finish(TWI_OK);
+		break;
+
+	case TW_MT_SLA_NACK:
+	case TW_MT_DATA_NACK:
+	case TW_MR_SLA_NACK:
+		finish(TWI_NACK);
+		break;
+
+	default:                                   // bus error / unexpected state
+		finish(TWI_BUS_ERROR);
+		break;
+	}
+}
+
+void twi_tick(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)          // also safe from a main-loop delay loop
+	{
+		if (active && --tmo == 0)
+		{
+			// The slave stopped answering (or is holding SDA): free the bus by hand
+			twi_recover();
+			finish(TWI_TIMEOUT);
+		}
+	}
+}
+
+void twi_recover(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		hal_twi_release();                         // TWI unit off, pins floating high
+
+		// up to 9 clocks lets a slave finish the byte it thinks it is sending
+		for (uint8_t i = 0; i < 9 && !hal_twi_sda_high(); i++)
+		{
+			hal_twi_scl(0); _delay_us(5);      // SCL low
+			hal_twi_scl(1); _delay_us(5);      // SCL high
+		}
+
+		hal_twi_sda(0); _delay_us(5);              // STOP: SDA low -> high with SCL high
+		hal_twi_sda(1); _delay_us(5);
+
+		hal_twi_ctrl(1 << TWEN);                   // hand the pins back to the TWI unit
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef TWI_H
+#define TWI_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL            // 16MHz clock (same board on every project)
+#endif
+
+// Interrupt-driven TWI (I2C) master with a small transaction queue.
+// Self-contained so other firmwares (Lab5 MAX517 DAC) can link it too.
+
+#ifndef TWI_QUEUE_LEN
+#define TWI_QUEUE_LEN 4             // pending transactions, power of two
+#endif
+
+// Transaction status (zero-initialized transfers start out idle)
+#define TWI_IDLE      0             // never submitted
+#define TWI_PENDING   1             // queued or on the bus
+#define TWI_OK        2             // all bytes written/read
+#define TWI_NACK      3             // slave NACKed address or data
+#define TWI_TIMEOUT   4             // no progress before timeout_ms, bus recovered
+#define TWI_BUS_ERROR 5             // illegal START/STOP seen on the bus
+
+typedef struct twiXfer twiXfer_t;
+struct twiXfer {
+	uint8_t  addr;              // 7-bit slave address
+	uint8_t  wlen;              // bytes written from wbuf first (0 = read only)
+	uint8_t  rlen;              // bytes read into rbuf after a repeated START
+	const uint8_t *wbuf;
+	uint8_t *rbuf;
+	uint8_t  timeout_ms;        // whole-transaction budget
+	volatile uint8_t status;    // TWI_* above, poll this from main
+	void (*done)(twiXfer_t *x); // optional, called from ISR context when finished
+};
+
+// Bit-rate register for a bus speed, folded at compile time (100kHz -> 72, 400kHz -> 12)
+#define TWI_TWBR(scl_hz) ((F_CPU / (scl_hz) - 16) / 2)
+
+void    twi_begin(uint8_t twbr);      // enable the TWI unit at a TWI_TWBR() rate
+static inline void twi_init(uint32_t scl_hz) { twi_begin(TWI_TWBR(scl_hz)); } // 100000 or 400000
+uint8_t twi_submit(twiXfer_t *x);     // queue a transfer, 0 if the queue is full
+uint8_t twi_idle(void);               // 1 when nothing is queued or in flight
+void    twi_tick(void);               // call every 1 ms, runs the timeouts
+void    twi_recover(void);            // clock SCL until a stuck slave lets go of SDA
+
+#endif
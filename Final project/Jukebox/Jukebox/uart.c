@@ -0,0 +1,32 @@
+// uart.c polled USART0 driver shared by the lab firmwares
+
+#include "uart.h"            // Header file (F_CPU default)
+#include "hal.h"             // USART0 registers
+
+void uart_begin(uint16_t ubrr)
+{
+	hal_uart_init(ubrr, 0);              // no RX interrupt, bytes are polled
+	hal_uart_tx_done();                  // stale TXC0 from before the reset
+}
+
+void uart_putc(char c)
+{
+	while (!hal_uart_tx_ready());        // UDR0 empty
+	hal_uart_put(c);
+}
+
+void uart_puts(const char *s)
+{
+	while (*s) uart_putc(*s++);
+}
+
+char uart_getc(void)
+{
+	while (!hal_uart_rx_ready());        // RXC0 set once a byte is in UDR0
+	return hal_uart_get();               // reading UDR0 clears RXC0
+}
+
+void uart_flush(void)
+{
+	while (!hal_uart_tx_done());         // TXC0: shift register empty
+}
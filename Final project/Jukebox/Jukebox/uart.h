@@ -0,0 +1,24 @@
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+
+// Polled USART0 driver (no interrupts): Lab5 console, tester MP3 link.
+// The interrupt-driven MP3 Trigger link lives in mp3.c instead.
+
+#ifndef F_CPU
+#define F_CPU 16000000UL            // 16MHz clock (same board on every project)
+#endif
+
+// Baud divisor, folded at compile time (9600 -> 103, 38400 -> 25)
+#define UART_UBRR(baud) ((F_CPU / (16UL * (baud))) - 1)
+
+void uart_begin(uint16_t ubrr);       // 8N1, TX + RX, at a UART_UBRR() rate
+static inline void uart_init(uint32_t baud) { uart_begin(UART_UBRR(baud)); }
+
+void uart_putc(char c);               // waits for room in UDR0
+void uart_puts(const char *s);        // sends a C string
+char uart_getc(void);                 // waits for a received byte
+void uart_flush(void);                // waits until the last byte is on the wire
+
+#endif
@@ -0,0 +1,127 @@
+// bench.c  -  cycle counts for the jukebox hot paths, run under simavr
+//
+// Built for the real ATmega328P with the Release flags (see Makefile).
+// Timer1 runs at clk/1, so TCNT1 is a CPU cycle counter; the cost of the
+// measurement itself is taken once and subtracted. Each result goes to the
+// simavr console register as "BENCH <name> <cycles>", and check_budgets.py
+// compares the lines against budgets.txt.
+
+#define main fw_main
+#include "main.c"            // display_song() and the ISRs are static/local there
+#undef main
+#include "rfid.c"            // poll transfer, to fake a finished card read
+
+#include <stdlib.h>          // utoa
+#include <avr/sleep.h>       // sleeping with interrupts off ends the simulation
+#include "avr_mcu_section.h" // simavr: MCU tag and console register
+
+AVR_MCU(F_CPU, "atmega328p");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+#define TIMER0_CALLS 200     // 1 ms ticks sampled for the worst case (covers an RFID poll)
+
+// Cycles spent in stmt; 0xFFFF if it ran past the 16-bit counter
+#define CYCLES(var, stmt) do {                                      \
+	TCNT1 = 0;                                                  \
+	TIFR1 = (1 << TOV1);                                        \
+	stmt;                                                       \
+	uint16_t t_ = TCNT1;                                        \
+	var = (TIFR1 & (1 << TOV1)) ? 0xFFFF : t_ - overhead;       \
+} while (0)
+
+// An ISR called as a function returns with reti, which sets the I bit
+#define ISR_CYCLES(var, vect) CYCLES(var, { vect(); cli(); })
+
+void USART_RX_vect(void);   // defined in mp3.c
+
+static uint16_t overhead = 0;
+
+static void out_str(const char *s)
+{
+	while (*s) GPIOR0 = *s++;
+}
+
+static void report(const char *name, uint16_t cycles)
+{
+	char num[6];
+	out_str("BENCH ");
+	out_str(name);
+	out_str(" ");
+	out_str(utoa(cycles, num, 10));
+	out_str("\n");
+}
+
+static void encoder_pins(uint8_t ab)     // drive A/B as outputs so PIND follows
+{
+	PORTD = (PORTD & ~((1 << PD2) | (1 << PD3))) | ((ab >> 1) << PD2) | ((ab & 1) << PD3);
+}
+
+int main(void)
+{
+	uint16_t c, worst;
+	char uid[MAX_UID_LEN];
+
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);                // Timer1 free-running at clk/1
+	CYCLES(overhead, );                  // cost of the empty measurement
+
+	// Same bring-up as the firmware, but interrupts stay off throughout
+	lcd_init();
+	lcd_create_char(0, music_icon);
+	twi_init(RFID_I2C_HZ);
+	tick_init();
+	mp3Init(38400);
+
+	lcd_clear();
+	CYCLES(c, lcd_puts("Thunderstruck   "));
+	report("lcd_puts", c);
+
+	CYCLES(c, display_song(TOTAL_SONGS - 1));
+	report("display_song", c);
+
+	CYCLES(c, mp3PlayTrack(12));         // two-byte binary trigger
+	report("mp3PlayTrack", c);
+
+	memcpy(rfid_buf, user_uid, MAX_UID_LEN);
+	rfid_xfer.status = TWI_OK;           // the poller just read a new card
+	CYCLES(c, rfid_read_uid(uid));
+	report("rfid_read_uid", c);
+
+	cards_init();                        // blank EEPROM: seeds the built-in cards
+	CYCLES(c, cards_find(uid));          // hash + the full UID compare at its home slot
+	report("cards_find", c);
+
+	plays_init();                        // blank EEPROM: all counts 0, catalog order
+	CYCLES(c, plays_count(TOTAL_SONGS - 1)); // worst pick: bubbles from the last rank to the top
+	report("plays_count", c);
+
+	// Encoder: one clockwise detent from rest, worst of the four edges
+	DDRD |= (1 << PD2) | (1 << PD3);
+	static const uint8_t cw[4] = { 1, 0, 2, 3 };
+	worst = 0;
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		encoder_pins(cw[i]);
+		ISR_CYCLES(c, PCINT2_vect);
+		if (c > worst) worst = c;
+	}
+	report("PCINT2_vect", worst);
+
+	// 1 ms tick with the LCD engine draining a full redraw and the RFID poll due
+	display_song(0);
+	worst = 0;
+	for (uint16_t i = 0; i < TIMER0_CALLS; i++)
+	{
+		ISR_CYCLES(c, TIMER0_COMPA_vect);
+		if (c > worst) worst = c;
+	}
+	report("TIMER0_COMPA_vect", worst);
+
+	ISR_CYCLES(c, USART_RX_vect);        // UDR0 reads 0: a 'Q' idle reply
+	report("USART_RX_vect", c);
+
+	out_str("BENCH done 0\n");
+	cli();
+	sleep_mode();
+	return 0;
+}
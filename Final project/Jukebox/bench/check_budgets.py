@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Compare the BENCH lines printed by bench.elf under simavr with budgets.
+
+usage: simavr ... bench.elf | check_budgets.py budgets.txt [--update]
+
+Fails (exit 1) when a path is over budget, overflowed the 16-bit cycle
+counter, or did not report at all. --update rewrites the budget file with
+the measured counts plus 10% headroom.
+
+A budget line may end in a "# ..." note; --update drops it with the old
+number. Header lines starting with "# UNMEASURED" mark the numbers as estimates
+that no simavr run has confirmed yet; they are reported as such and
+--update removes them.
+"""
+
+import re
+import sys
+
+HEADROOM = 1.10
+UNMEASURED = '# UNMEASURED'
+
+
+def read_budgets(path):
+    budgets, header = {}, []
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#') or not line.strip():
+                header.append(line)
+                continue
+            name, cycles = line.split('#')[0].split()   # "# ..." notes a line
+            budgets[name] = int(cycles)
+    return budgets, header
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    path = sys.argv[1]
+    update = '--update' in sys.argv[2:]
+    budgets, header = read_budgets(path)
+
+    measured = {}
+    for line in sys.stdin:
+        m = re.search(r'BENCH (\S+) (\d+)', line)
+        if m and m.group(1) != 'done':
+            measured[m.group(1)] = int(m.group(2))
+
+    if update:
+        with open(path, 'w') as f:
+            f.writelines(l for l in header if not l.startswith(UNMEASURED))
+            for name, cycles in measured.items():
+                f.write('%-20s %d\n' % (name, int(cycles * HEADROOM)))
+        print('wrote %d budgets to %s' % (len(measured), path))
+        return
+
+    if any(l.startswith(UNMEASURED) for l in header):
+        print('%s holds unmeasured estimates: run `make budgets` to replace them' % path)
+
+    failed = False
+    print('%-20s %8s %8s' % ('path', 'cycles', 'budget'))
+    for name, budget in budgets.items():
+        cycles = measured.get(name)
+        if cycles is None:
+            verdict, failed = 'MISSING', True
+        elif cycles >= 0xFFFF:
+            verdict, failed = 'OVERFLOW', True
+        elif cycles > budget:
+            verdict, failed = 'OVER', True
+        else:
+            verdict = 'ok'
+        print('%-20s %8s %8d  %s' % (name, '-' if cycles is None else cycles, budget, verdict))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,75 @@
+// hal_host.h  -  hal.h backed by the simulated peripherals in sim.c
+
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdint.h>
+
+// TWCR bit positions, as on the ATmega328P
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWEN  2
+#define TWIE  0
+
+#define HAL_BTN_SELECT 0x01
+#define HAL_BTN_ADMIN  0x02
+
+void    hal_wdt_off(void);
+void    hal_wdt_on(void);
+void    hal_wdt_kick(void);
+void    hal_irq_on(void);
+void    hal_idle(void);
+void    hal_power_init(void);
+
+void    hal_tick_init(uint8_t top);
+uint8_t hal_tick_count(void);
+uint8_t hal_tick_pending(void);
+
+void     hal_stamp_init(void);
+uint16_t hal_stamp(void);
+
+void    hal_gap_init(void);
+void    hal_gap_start(void);
+void    hal_gap_stop(void);
+
+void    hal_uart_init(uint16_t ubrr, uint8_t rx_irq);
+uint8_t hal_uart_tx_ready(void);
+uint8_t hal_uart_rx_ready(void);
+uint8_t hal_uart_tx_done(void);
+void    hal_uart_tx_irq_on(void);
+void    hal_uart_tx_irq_off(void);
+void    hal_uart_put(uint8_t c);
+uint8_t hal_uart_get(void);
+
+void    hal_busy_init(uint8_t irq);
+uint8_t hal_busy_idle(void);
+
+void    hal_lcd_init_pins(void);
+void    hal_lcd_data(uint8_t n);
+void    hal_lcd_rs(uint8_t on);
+void    hal_lcd_e(uint8_t on);
+
+void    hal_twi_init(uint8_t twbr);
+void    hal_twi_ctrl(uint8_t v);
+uint8_t hal_twi_status(void);
+void    hal_twi_put(uint8_t d);
+uint8_t hal_twi_get(void);
+void    hal_twi_release(void);
+void    hal_twi_scl(uint8_t high);
+void    hal_twi_sda(uint8_t high);
+uint8_t hal_twi_sda_high(void);
+
+void     hal_noise_init(void);
+uint16_t hal_noise_sample(void);
+void     hal_noise_off(void);
+void     hal_amp_init(void);
+void     hal_amp(uint8_t on);
+
+void    hal_encoder_init(void);
+uint8_t hal_encoder_ab(void);
+void    hal_buttons_init(void);
+uint8_t hal_buttons(void);
+
+#endif
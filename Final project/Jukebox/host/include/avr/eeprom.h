@@ -0,0 +1,15 @@
+// host shim: the 1 KB EEPROM lives in sim.c, with the 3.4 ms write time
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include <stdint.h>
+#include "sim.h"
+
+#define EEMEM
+#define eeprom_is_ready()  sim_eeprom_ready()
+#define eeprom_busy_wait() do { } while (!eeprom_is_ready())
+
+uint8_t eeprom_read_byte(const uint8_t *p);
+void    eeprom_write_byte(uint8_t *p, uint8_t v);    // waits for a write still in progress
+
+#endif
@@ -0,0 +1,11 @@
+// host shim: ISR() becomes a plain function the simulator calls
+#ifndef SIM_INTERRUPT_H
+#define SIM_INTERRUPT_H
+
+#include "sim.h"
+
+#define ISR(vec) void vec(void); void vec(void)
+#define sei() sim_sei()
+#define cli() sim_cli()
+
+#endif
@@ -0,0 +1,17 @@
+// host shim: flash and RAM share one address space
+#ifndef SIM_PGMSPACE_H
+#define SIM_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define strncpy_P strncpy
+#define strlen_P  strlen
+#define memcpy_P  memcpy
+
+#endif
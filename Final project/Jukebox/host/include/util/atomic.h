@@ -0,0 +1,15 @@
+// host shim: ATOMIC_BLOCK masks the simulated interrupts for the block
+#ifndef SIM_ATOMIC_H
+#define SIM_ATOMIC_H
+
+#include <stdint.h>
+#include "sim.h"
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON      0
+
+#define ATOMIC_BLOCK(type) \
+	for (uint8_t sim_sreg_ __attribute__((cleanup(sim_irq_restore))) = sim_irq_save(), \
+	     sim_once_ = 1; sim_once_; sim_once_ = 0)
+
+#endif
@@ -0,0 +1,15 @@
+// host shim: the C equivalents avr-libc documents for its CRC helpers
+#ifndef SIM_CRC16_H
+#define SIM_CRC16_H
+
+#include <stdint.h>
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	return crc;
+}
+
+#endif
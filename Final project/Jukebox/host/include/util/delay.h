@@ -0,0 +1,10 @@
+// host shim: busy-waits advance the virtual clock (and run due ISRs)
+#ifndef SIM_DELAY_H
+#define SIM_DELAY_H
+
+#include "sim.h"
+
+#define _delay_us(us) sim_delay_us((double)(us))
+#define _delay_ms(ms) sim_delay_us((double)(ms) * 1000.0)
+
+#endif
@@ -0,0 +1,820 @@
+// scenarios.c  -  deterministic end-to-end runs of the jukebox firmware
+//
+// usage: jukebox_sim <scenario>     (jukebox_sim with no argument lists them)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "sim.h"
+#include "jukebox_config.h"
+#include "catalog.h"
+#include "mp3.h"
+#include "shuffle.h"
+#include "power.h"
+#include "persist.h"
+#include "bootprof.h"
+#include "cards.h"
+#include "plays.h"
+#include "instr.h"
+#include "evq.h"
+#include "buttons.h"
+#include "lcd.h"
+#include <util/crc16.h>
+
+#define CHECK(c) do { if (!(c)) { \
+	fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); \
+	dump(); exit(1); } } while (0)
+
+static char line[2][17];
+
+static void dump(void)
+{
+	sim_lcd_line(0, line[0]);
+	sim_lcd_line(1, line[1]);
+	fprintf(stderr, "  LCD |%s|\n      |%s|\n  MP3 %s\n", line[0], line[1], sim_mp3_log());
+}
+
+static void screen(void)
+{
+	sim_lcd_line(0, line[0]);
+	sim_lcd_line(1, line[1]);
+}
+
+static uint8_t shows(uint8_t row, const char *s) { screen(); return strstr(line[row], s) != NULL; }
+
+static void press(uint8_t btn, uint32_t hold_ms)
+{
+	sim_buttons(btn);
+	sim_run_ms(hold_ms);
+	sim_buttons(0);
+	sim_run_ms(50);
+}
+
+static void tap_card(const char *uid)
+{
+	sim_rfid_present(uid);
+	sim_run_ms(120);
+	sim_rfid_present(NULL);
+	sim_run_ms(50);
+}
+
+// One detent: clockwise 11 -> 01 -> 00 -> 10 -> 11, the reverse for ccw
+static void turn(int8_t dir, uint32_t gap_ms)
+{
+	static const uint8_t cw[4] = { 1, 0, 2, 3 }, ccw[4] = { 2, 0, 1, 3 };
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		sim_encoder_edge(dir > 0 ? cw[i] : ccw[i]);
+		sim_run_ms(2);
+	}
+	sim_run_ms(gap_ms);
+}
+
+static uint8_t shows_song(uint8_t idx)
+{
+	char title[CATALOG_NAME_MAX + 1];
+	catalog_title(idx, title);
+	screen();
+	return !strncmp(line[0], title, strlen(title));
+}
+
+// ---------- Scenarios
+static void boot(void)
+{
+	sim_run_ms(300);
+	CHECK(shows_song(0));
+	CHECK(shows(1, "C:0"));
+	CHECK(!strcmp(sim_mp3_log(), "Q"));            // state query at power-up, an idle Trigger needs no stop
+	CHECK(sim_lcd_violations() == 0);
+}
+
+// ms from power-up until the song screen is complete on the glass
+static uint32_t first_frame_ms(void)
+{
+	while (sim_now_us() < 1000000)
+	{
+		sim_run_ms(1);                          // boot delays run inside the first call
+		if (shows_song(0) && shows(1, "C:0")) break;
+	}
+	return sim_now_us() / 1000;
+}
+
+// Overlapped bring-up; the admin button held at power-up shows the breakdown
+static void boot_profile(void)
+{
+	sim_buttons(HAL_BTN_ADMIN);
+	uint32_t frame = first_frame_ms();
+	CHECK(frame < LCD_POWERUP_MS + 10);             // was ~190 ms with the serial waits
+	CHECK(sim_lcd_violations() == 0);
+
+	sim_run_ms(200);
+	CHECK(!strcmp(sim_mp3_log(), "Q"));            // nothing sent while the Trigger booted
+	CHECK(boot_ms(BOOT_TRIGGER) >= MP3_BOOT_MS && boot_ms(BOOT_TRIGGER) < MP3_BOOT_MS + 30);
+	for (uint8_t i = 1; i < BOOT_FRAME + 1; i++) CHECK(boot_ms(i) >= boot_ms(i - 1));
+	CHECK(shows(0, "In") && shows(0, " L") && shows(1, "Frm") && shows(1, "MP3"));
+
+	sim_buttons(0);                                 // letting go is not a stop press
+	sim_run_ms(5000);
+	CHECK(shows_song(0) && !strcmp(sim_mp3_log(), "Q"));
+	printf("boot_profile: inputs %u, restore %u, lcd %u, frame %u, trigger %u ms\n",
+	       boot_ms(BOOT_INPUTS), boot_ms(BOOT_RESTORE), boot_ms(BOOT_LCD),
+	       boot_ms(BOOT_FRAME), boot_ms(BOOT_TRIGGER));
+}
+
+static void credit_play(void)
+{
+	sim_mp3_track_ms(3000);
+	sim_run_ms(300);
+
+	sim_rfid_present(user_uid);                     // card left on the reader counts once
+	sim_run_ms(1000);
+	sim_rfid_present(NULL);
+	sim_run_ms(50);
+	CHECK(shows(1, "C:1"));
+
+	sim_run_ms(RFID_HOLD_MS);                       // away long enough, counts again
+	tap_card(user_uid);
+	CHECK(shows(1, "C:2"));
+
+	press(HAL_BTN_SELECT, 100);
+	CHECK(sim_mp3_plays() == 1 && sim_mp3_track() == catalog_track(0));
+	CHECK(sim_mp3_playing() && mp3IsBusy());
+	CHECK(shows(1, "C:1"));
+	CHECK(line[1][15] == '*');                      // note glyph on the playing song
+
+	sim_run_ms(3500);                               // track ends, Trigger sends 'X'
+	CHECK(!sim_mp3_playing() && !mp3IsBusy());
+	CHECK(sim_lcd_violations() == 0);
+}
+
+static void no_credit(void)
+{
+	sim_run_ms(300);
+	press(HAL_BTN_SELECT, 100);
+	sim_run_ms(100);
+	CHECK(sim_mp3_plays() == 0);
+	CHECK(!strcmp(sim_mp3_log(), "Q"));
+	CHECK(shows(1, "C:0"));
+}
+
+static void admin_shuffle(void)
+{
+	sim_mp3_track_ms(1500);
+	sim_run_ms(300);
+
+	tap_card(admin_uid);
+	CHECK(shows(0, "ADMIN") && shows(1, "ENABLED"));
+	sim_run_ms(2600);                               // message times out
+	CHECK(shows(1, "C:I"));
+
+	press(HAL_BTN_ADMIN, 2100);                     // long press (>= 2 s)
+	CHECK(shows(0, "Shuffle ON"));
+	CHECK(sim_mp3_plays() == 1);                    // idle player starts right away
+
+	sim_run_ms(1600);                               // 'X' -> next random track
+	CHECK(sim_mp3_plays() == 2 && sim_mp3_playing());
+	sim_run_ms(1600);
+	CHECK(sim_mp3_plays() == 3);
+
+	press(HAL_BTN_ADMIN, 100);                      // click: a stop, not a skip to the next
+	sim_run_ms(BTN_DOUBLE_MS + 3000);
+	CHECK(sim_mp3_plays() == 3 && !sim_mp3_playing());
+
+	tap_card(admin_uid);
+	CHECK(shows(0, "ADMIN") && shows(1, "DISABLED"));
+}
+
+// Two full shuffle cycles: every song once per cycle, no back-to-back repeat
+static void shuffle_order(void)
+{
+	uint8_t seen[2][TOTAL_SONGS] = { { 0 } };
+	int16_t prev = -1;
+	uint16_t plays = 0;
+
+	sim_mp3_track_ms(200);
+	sim_run_ms(300);
+	tap_card(admin_uid);
+	press(HAL_BTN_ADMIN, 2100);
+	while (plays < 2 * TOTAL_SONGS)
+	{
+		sim_run_ms(1);
+		if (sim_mp3_plays() == plays) continue;
+		int16_t idx = catalog_find(sim_mp3_track());
+		CHECK(idx >= 0 && idx != prev);
+		CHECK(!seen[plays / TOTAL_SONGS][idx]++);
+		prev = idx;
+		plays = sim_mp3_plays();
+	}
+
+	uint8_t a[TOTAL_SONGS], b[TOTAL_SONGS];             // another power-up, another order
+	shuffle_init(shuffle_entropy());
+	for (uint8_t i = 0; i < TOTAL_SONGS; i++) a[i] = shuffle_next();
+	shuffle_init(shuffle_entropy());
+	for (uint8_t i = 0; i < TOTAL_SONGS; i++) b[i] = shuffle_next();
+	CHECK(memcmp(a, b, TOTAL_SONGS));
+}
+
+static void queue(void)
+{
+	sim_mp3_track_ms(2000);
+	sim_run_ms(300);
+	tap_card(user_uid);
+	sim_run_ms(RFID_HOLD_MS);
+	tap_card(user_uid);
+
+	press(HAL_BTN_SELECT, 100);                     // idle player: plays now
+	turn(+1, 100);
+	press(HAL_BTN_SELECT, 100);                     // busy: waits its turn
+	CHECK(sim_mp3_plays() == 1 && sim_mp3_track() == catalog_track(0));
+	CHECK(shows(0, "Queued #1"));
+	CHECK(mp3QueueLen() == 1);
+	sim_run_ms(1200);
+	CHECK(shows_song(1) && shows(1, "C:0"));
+	CHECK(line[1][15] == '1');                      // queue position on the song screen
+
+	sim_run_ms(1000);                               // 'X' -> queued track starts from the ISR
+	CHECK(sim_mp3_plays() == 2 && sim_mp3_track() == catalog_track(1));
+	CHECK(!strchr(sim_mp3_log(), 'O'));         // no stop command, the pick cancels the old track
+	CHECK(sim_mp3_gap_us() < (MP3_CMD_GAP_MS + 1) * 1000UL); // at worst behind one command gap
+	CHECK(mp3QueueLen() == 0);
+	sim_run_ms(50);
+	CHECK(shows_song(1) && line[1][15] == '*');
+	CHECK(sim_lcd_violations() == 0);
+
+	mp3Queue(catalog_track(2));
+	mp3Queue(catalog_track(3));
+	mp3Stop();                                      // the queue holds after a stop
+	sim_run_ms(2500);
+	CHECK(!sim_mp3_playing() && sim_mp3_plays() == 2 && mp3QueueLen() == 2);
+	CHECK(mp3Queue(catalog_track(4)) == 2);         // the next pick resumes it, oldest first
+	sim_run_ms(50);
+	CHECK(sim_mp3_plays() == 3 && sim_mp3_track() == catalog_track(2) && mp3QueueLen() == 2);
+}
+
+// ms from a detent until the first new character reaches the glass
+static uint32_t knob_latency_ms(int8_t dir)
+{
+	uint32_t w = sim_lcd_writes(), ms = 0;
+	turn(dir, 0);
+	while (sim_lcd_writes() == w && ms < 100) { sim_run_ms(1); ms++; }
+	return ms + 2;                                  // turn() ran 2 ms past the detent edge
+}
+
+static void idle_power(void)
+{
+	sim_mp3_track_ms(1000);
+	sim_run_ms(300);
+	uint32_t awake = knob_latency_ms(+1);
+	CHECK(!power_idle() && !sim_amp_on());
+
+	sim_run_ms(POWER_IDLE_MS + 200);                // nobody at the machine
+	CHECK(power_idle());
+	uint32_t p = sim_rfid_polls();
+	uint64_t z = sim_sleep_us();
+	sim_run_ms(1000);
+	CHECK(sim_rfid_polls() - p <= 1000 / RFID_BEACON_MS + 1);
+	uint64_t asleep = sim_sleep_us() - z;
+	CHECK(asleep > 900000);                         // MCU sleeps >90% of the time
+
+	uint32_t idle = knob_latency_ms(+1);            // wakes on the pin change
+	CHECK(!power_idle());
+	CHECK(idle < 30 && idle <= awake + 1);
+	p = sim_rfid_polls();
+	sim_run_ms(1000);
+	CHECK(sim_rfid_polls() - p >= 1000 / RFID_POLL_MS - 1);
+
+	tap_card(user_uid);
+	press(HAL_BTN_SELECT, 100);
+	CHECK(sim_mp3_playing() && sim_amp_on());
+	sim_run_ms(1000 + POWER_AMP_OFF_MS - 500);      // short pause after the track: amp stays up
+	CHECK(!sim_mp3_playing() && sim_amp_on());
+	sim_run_ms(700);
+	CHECK(!sim_amp_on());
+	printf("idle_power: knob to LCD %u ms awake, %u ms from idle; asleep %u%% while idle\n",
+	       awake, idle, (unsigned)(asleep / 10000));
+}
+
+// Journal slot as persist.c lays it out: seq, credits, card, flags, song, 0, crc8
+static void put_record(uint8_t slot, uint16_t seq, uint8_t credits, uint8_t song, uint8_t torn)
+{
+	uint8_t r[8] = { seq & 0xFF, seq >> 8, credits, 0xFF, 0, song, 0, 0 };
+	for (uint8_t i = 0; i < 7; i++) r[7] = _crc8_ccitt_update(r[7], r[i]);
+	if (torn) r[7] ^= 0x5A;
+	for (uint8_t i = 0; i < 8; i++) sim_eeprom_poke(PERSIST_ADDR + slot * 8 + i, r[i]);
+}
+
+static uint16_t record_seq(uint8_t slot)
+{
+	return sim_eeprom_peek(PERSIST_ADDR + slot * 8) | sim_eeprom_peek(PERSIST_ADDR + slot * 8 + 1) << 8;
+}
+
+static void persist(void)
+{
+	put_record(3, 41, 3, 2, 0);
+	put_record(4, 42, 9, 4, 1);                     // torn by a brown-out mid-write
+	sim_run_ms(300);
+	CHECK(shows_song(2) && shows(1, "C:0"));        // older, intact record wins, no card paying
+
+	tap_card(user_uid);
+	CHECK(shows(1, "C:1") && persist_records() == 0);   // batched, not written per change
+	sim_run_ms(PERSIST_MIN_MS);
+	CHECK(persist_records() == 1);
+	CHECK(record_seq(4) == 42 &&                    // torn slot reused with the next seq
+	       sim_eeprom_peek(PERSIST_ADDR + 4 * 8 + 2) == 1);
+
+	uint64_t t0 = sim_now_us();
+	for (uint8_t i = 0; i < 12; i++)                // a busy stretch of credit changes
+	{
+		tap_card(user_uid);
+		sim_run_ms(RFID_HOLD_MS);
+	}
+	sim_run_ms(PERSIST_MIN_MS + 500);
+	uint32_t secs = (sim_now_us() - t0) / 1000000;
+	CHECK(persist_records() - 1 <= secs * 1000 / PERSIST_MIN_MS + 1);
+
+	uint8_t newest = 0;                             // last record holds the final balance
+	for (uint8_t i = 1; i < PERSIST_SLOTS; i++)
+		if ((int16_t)(record_seq(i) - record_seq(newest)) > 0 && record_seq(i) != 0xFFFF) newest = i;
+	CHECK(record_seq(newest) == 41 + persist_records());
+	CHECK(sim_eeprom_peek(PERSIST_ADDR + newest * 8 + 2) == 13);
+	CHECK(sim_eeprom_peek(PERSIST_ADDR + newest * 8 + 3) == cards_find(user_uid));
+	for (uint16_t a = PERSIST_ADDR; a < PERSIST_ADDR + PERSIST_SLOTS * 8; a++)
+		CHECK(sim_eeprom_wear(a) <= 1);             // spread over the ring
+	CHECK(sim_lcd_violations() == 0);
+}
+
+// The free-running sequence wraps: a record numbered 0xFFFF is as valid as any other
+static void persist_wrap(void)
+{
+	put_record(5, 0xFFFE, 1, 3, 0);
+	put_record(6, 0xFFFF, 2, 4, 0);
+	put_record(7, 0x0000, 3, 5, 0);
+	sim_run_ms(300);
+	CHECK(shows_song(5));                           // 0x0000 is newer than 0xFFFF
+
+	tap_card(user_uid);
+	sim_run_ms(PERSIST_MIN_MS);
+	CHECK(persist_records() == 1 && record_seq(8) == 1);
+
+	for (uint8_t i = 0; i < 16; i++)                // erase the last two: 0xFFFF is the newest
+		sim_eeprom_poke(PERSIST_ADDR + 7 * 8 + i, 0xFF);
+	persistState_t st;
+	CHECK(persist_load(&st) && st.song == 4 && st.credits == 2);
+}
+
+// Pick counts from the EEPROM, the popularity order kept by bubbling, and the knob walking it
+static void plays(void)
+{
+	static const uint8_t picks[TOTAL_SONGS] = { [1] = 4, [4] = 6, [8] = 4 };
+	sim_eeprom_poke(PLAYS_ADDR, 0x5A);
+	for (uint8_t i = 0; i < TOTAL_SONGS; i++) sim_eeprom_poke(PLAYS_ADDR + catalog_track(i), picks[i]);
+	sim_mp3_track_ms(60000);
+	sim_run_ms(300);
+	CHECK(plays_ranked(0) == 4 && plays_ranked(1) == 1 && plays_ranked(2) == 8);   // ties in catalog order
+
+	tap_card(admin_uid);
+	sim_run_ms(2600);
+	for (uint8_t i = 0; i < 8; i++) turn(+1, 100);
+	press(HAL_BTN_SELECT, 60);                      // one more for song 8 moves it past song 1
+	CHECK(plays_get(8) == 5 && plays_ranked(1) == 8 && plays_rank(1) == 2);
+
+	sim_buttons(HAL_BTN_ADMIN);                     // PD5 held + PD4: popularity order
+	sim_run_ms(50);
+	sim_buttons(HAL_BTN_ADMIN | HAL_BTN_SELECT);
+	sim_run_ms(60);
+	sim_buttons(HAL_BTN_ADMIN);
+	sim_run_ms(50);
+	sim_buttons(0);
+	sim_run_ms(50);
+	CHECK(shows(1, "popularity") && plays_get(8) == 5);   // no pick, no count
+	sim_run_ms(1000);
+	CHECK(shows_song(4) && !strchr(sim_mp3_log(), 'O'));  // top of the list, PD5 release no stop
+	turn(+1, 100);
+	CHECK(shows_song(8));
+	turn(+1, 100);
+	CHECK(shows_song(1));
+	for (uint8_t i = 0; i < 3; i++) turn(-1, 100);   // wraps to the last of the unplayed
+	CHECK(shows_song(9));
+
+	CHECK(sim_eeprom_peek(PLAYS_ADDR + catalog_track(8)) == 4);   // still batched
+	sim_run_ms(PLAYS_FLUSH_MS);
+	CHECK(sim_eeprom_peek(PLAYS_ADDR + catalog_track(8)) == 5);
+	for (uint8_t i = 0; i < TOTAL_SONGS; i++)
+		CHECK(sim_eeprom_wear(PLAYS_ADDR + catalog_track(i)) == (i == 8));   // unchanged counts not rewritten
+
+	for (uint16_t i = 0; i < 256; i++) plays_count(0);   // saturates: everything halves once
+	CHECK(plays_get(0) == 128 && plays_get(4) == 3 && plays_get(8) == 2 && plays_get(1) == 2);
+	CHECK(plays_ranked(0) == 0 && plays_ranked(1) == 4 && plays_ranked(2) == 8 && plays_ranked(3) == 1);
+	for (uint8_t r = 1; r < TOTAL_SONGS; r++)
+		CHECK(plays_get(plays_ranked(r - 1)) >= plays_get(plays_ranked(r)) && plays_rank(plays_ranked(r)) == r);
+
+	sim_run_ms(PLAYS_FLUSH_MS + 50);                     // halving under way: table marked torn
+	CHECK(sim_eeprom_peek(PLAYS_ADDR) != 0x5A && sim_eeprom_peek(PLAYS_ADDR + catalog_track(0)) == 128);
+	sim_run_ms(TOTAL_SONGS * 10 + 100);
+	CHECK(sim_eeprom_peek(PLAYS_ADDR) == 0x5A && sim_eeprom_peek(PLAYS_ADDR + catalog_track(4)) == 3);
+}
+
+// Per-card balances, enrollment by tap, and a table filled to 80 %
+static void cards(void)
+{
+	static const char guest[MAX_UID_LEN] = { 0x3A, 0x01, 0x22, 0x33, 0x44, 0x6E };
+	sim_run_ms(300);
+	CHECK(cards_count() == 2);                      // built-in cards seeded on a blank EEPROM
+
+	tap_card(guest);
+	CHECK(shows(0, "Unknown card"));
+	sim_run_ms(1500 + RFID_HOLD_MS);
+
+	tap_card(admin_uid);                            // admin, then PD5 held 5 s: enroll mode
+	sim_run_ms(2600);
+	press(HAL_BTN_ADMIN, ENROLL_PRESS_MS + 100);
+	CHECK(shows(0, "Enroll: tap card"));
+	sim_run_ms(1600);
+	CHECK(shows(1, "ENRL"));
+	tap_card(guest);
+	CHECK(shows(0, "Card added") && cards_count() == 3);
+	sim_run_ms(200);                                // a reset now: the table reloads from the EEPROM
+	cards_init();
+	CHECK(cards_count() == 3 && cards_find(guest) != CARD_NONE);
+	sim_run_ms(1300 + RFID_HOLD_MS);
+	tap_card(admin_uid);                            // ends enrollment, admin stays on
+	CHECK(shows(0, "Enroll done"));
+	sim_run_ms(1500 + RFID_HOLD_MS);
+	tap_card(admin_uid);                            // admin off
+	sim_run_ms(2600);
+
+	tap_card(guest);                                // each card has its own balance
+	CHECK(shows(1, "C:1"));
+	tap_card(user_uid);
+	CHECK(shows(1, "C:1"));
+	sim_run_ms(RFID_HOLD_MS);
+	tap_card(user_uid);
+	CHECK(shows(1, "C:2"));
+	press(HAL_BTN_SELECT, 100);                     // paid from the user card
+	CHECK(sim_mp3_plays() == 1 && shows(1, "C:1"));
+	sim_run_ms(RFID_HOLD_MS);
+	tap_card(guest);
+	CHECK(shows(1, "C:2"));
+	CHECK(cards_balance(cards_find(user_uid)) == 1);
+
+	sim_run_ms(CARD_FLUSH_MS);                      // balances batched, not written per tap
+	uint16_t meta = CARD_ADDR + cards_find(user_uid) * (MAX_UID_LEN + 1) + MAX_UID_LEN;
+	uint16_t wear = sim_eeprom_wear(meta);
+	turn(+1, 100);                                  // reader back to full rate
+	for (uint8_t i = 0; i < 10; i++) { tap_card(user_uid); sim_run_ms(RFID_HOLD_MS); }
+	CHECK(shows(1, "C:11") && sim_eeprom_wear(meta) == wear);
+	sim_run_ms(CARD_FLUSH_MS);
+	CHECK(sim_eeprom_wear(meta) == wear + 1 && sim_eeprom_peek(meta) == 11);
+	turn(-1, 100);
+
+	tap_card(admin_uid);                            // remove the guest card again
+	sim_run_ms(2600);
+	press(HAL_BTN_ADMIN, ENROLL_PRESS_MS + 100);
+	sim_run_ms(1500 + RFID_HOLD_MS);
+	tap_card(guest);
+	CHECK(shows(0, "Card removed") && cards_count() == 2);
+	sim_run_ms(200);
+	cards_init();
+	CHECK(cards_count() == 2 && cards_find(guest) == CARD_NONE);
+
+	char uid[MAX_UID_LEN];                          // look-alikes of enrolled cards never match
+	memcpy(uid, user_uid, MAX_UID_LEN);
+	uid[5] ^= 0x40;                                 // checksum byte differs
+	CHECK(cards_find(uid) == CARD_NONE);
+	memcpy(uid, admin_uid, MAX_UID_LEN);
+	uid[0] ^= 0x01; uid[1] ^= 0x01;                 // same uid[0] ^ uid[1]
+	CHECK(cards_find(uid) == CARD_NONE);
+
+	uid[0] = 0x3A; uid[5] = 0;                      // fill the table to ~80 %
+	for (uint8_t i = 0; i < CARD_SLOTS * 4 / 5; i++)
+	{
+		uid[1] = i; uid[2] = i * 7; uid[3] = 0x5A ^ i; uid[4] = i * 13;
+		CHECK(cards_add(uid, CARD_USER) != CARD_NONE);
+	}
+	for (uint8_t i = 0; i < CARD_SLOTS * 4 / 5; i++)
+	{
+		uid[1] = i; uid[2] = i * 7; uid[3] = 0x5A ^ i; uid[4] = i * 13;
+		CHECK(cards_find(uid) != CARD_NONE);
+	}
+	CHECK(cards_find(guest) == CARD_NONE && cards_find(admin_uid) != CARD_NONE);
+	CHECK(cards_count() == 2 + CARD_SLOTS * 4 / 5);
+}
+
+// Knob bursts while queued tracks roll over: every detent and every reply reaches main
+static void events(void)
+{
+	sim_mp3_track_ms(600);
+	sim_run_ms(300);
+	tap_card(admin_uid);
+	sim_run_ms(2600);
+
+	press(HAL_BTN_SELECT, 100);                     // song 0 plays, 1 and 2 queue behind it
+	turn(+1, 0);
+	press(HAL_BTN_SELECT, 100);
+	turn(+1, 0);
+	press(HAL_BTN_SELECT, 100);
+	CHECK(mp3QueueLen() == 2);
+
+	for (uint8_t i = 0; i < 150; i++) turn(+1, 0);  // 1.2 s of fast spin across both 'X'
+	CHECK(sim_mp3_plays() == 3);
+	sim_run_ms(100);
+	CHECK(shows_song((2 + 1 + 149 * ENC_FAST_STEP) % TOTAL_SONGS));
+	CHECK(evq_dropped() == 0);
+
+	sim_run_ms(10500);                               // snaps back to the last track started
+	CHECK(shows_song(2) && line[1][15] == '*');
+}
+
+// PD4 contacts chatter, flipping every ms for ms, then settle (down = pressed)
+static void bounce(uint8_t down, uint8_t ms)
+{
+	for (uint8_t i = 0; i < ms; i++) { sim_buttons(((i ^ down) & 1) ? HAL_BTN_SELECT : 0); sim_run_ms(1); }
+	sim_buttons(down ? HAL_BTN_SELECT : 0);
+}
+
+// Debounced presses without a blocking delay, gestures on PD5
+static void buttons(void)
+{
+	sim_mp3_track_ms(60000);
+	sim_run_ms(300);
+	tap_card(user_uid);
+	sim_run_ms(RFID_HOLD_MS);
+	tap_card(user_uid);
+	CHECK(shows(1, "C:2"));
+
+	instr_reset();
+	bounce(1, 9);                                   // one press, nine edges
+	uint32_t ms = 0;
+	while (!sim_mp3_plays() && ms < 100) { sim_run_ms(1); ms++; }
+	CHECK(ms <= 4 * BTN_SAMPLE_MS + BTN_SAMPLE_MS); // fixed debounce after the contacts settle
+	sim_run_ms(100);
+	bounce(0, 9);
+	sim_run_ms(100);
+	CHECK(sim_mp3_plays() == 1 && shows(1, "C:1"));
+	instrStats_t st;
+	instr_get(&st);
+	CHECK(INSTR_US(st.loop_max) <= 1010 && INSTR_US(st.busy_max) <= 100);   // nothing blocks the loop any more
+
+	tap_card(admin_uid);
+	sim_run_ms(2600);
+	press(HAL_BTN_ADMIN, 80);                       // double-click: volume screen, no stop
+	press(HAL_BTN_ADMIN, 80);
+	sim_run_ms(BTN_DOUBLE_MS);
+	CHECK(shows(0, "Volume") && !strchr(sim_mp3_log(), 'O'));
+	sim_run_ms(3500);
+	press(HAL_BTN_ADMIN, 80);                       // single click: stop, once the double window closed
+	CHECK(!strchr(sim_mp3_log(), 'O'));
+	sim_run_ms(BTN_DOUBLE_MS);
+	CHECK(strchr(sim_mp3_log(), 'O'));
+	printf("buttons: select press to play %u ms after the last bounce\n", ms);
+}
+
+static unsigned count_cmd(char c)
+{
+	unsigned n = 0;
+	for (const char *p = sim_mp3_log(); *p; p++) n += (*p == c);
+	return n;
+}
+
+// Admin volume on the knob; only the newest volume/track goes out, with the track's gain
+static void volume(void)
+{
+	sim_mp3_track_ms(60000);
+	sim_run_ms(300);
+	tap_card(admin_uid);
+	sim_run_ms(2600);
+
+	press(HAL_BTN_ADMIN, 80);                       // double-click opens the volume screen
+	press(HAL_BTN_ADMIN, 80);
+	sim_run_ms(BTN_DOUBLE_MS);
+	CHECK(shows(0, "Volume") && shows(0, "20"));
+	for (uint8_t i = 0; i < 30; i++) turn(-1, 0);   // past the bottom
+	sim_run_ms(50);
+	unsigned spun = count_cmd('v');
+	CHECK(shows(0, " 0") && line[1][0] == ' ');
+	CHECK(mp3Volume() == MP3_VOL_LEVELS * MP3_VOL_STEP && sim_mp3_volume() == mp3Volume());
+	CHECK(spun <= MP3_VOL_LEVELS);                  // clamped detents send nothing
+	for (uint8_t i = 0; i < 15; i++) turn(+1, 0);
+	sim_run_ms(3500);                               // screen times out, the knob browses again
+	CHECK(sim_mp3_volume() == 5 * MP3_VOL_STEP);
+
+	unsigned v0 = count_cmd('v');                   // back-to-back requests before the line frees up
+	for (uint8_t i = 0; i < 20; i++) mp3SetVolume(i);
+	mp3PlayTrack(3);
+	mp3PlayTrack(catalog_track(8));                 // Thunderstruck, gain -8
+	sim_run_ms(50);
+	const char *log = sim_mp3_log();
+	unsigned burst = count_cmd('v') - v0;           // the first goes out at once, the rest wait for it
+	CHECK(burst == 2 && sim_mp3_plays() == 1 && sim_mp3_track() == 9);
+	CHECK(sim_mp3_volume() == 19 + 8);              // quieter track, more attenuation
+	CHECK(!strcmp(log + strlen(log) - 3, "vT9"));   // volume lands before the track starts
+
+	mp3PlayTrack(catalog_track(5));                 // Let It Be, gain +4
+	sim_run_ms(50);
+	CHECK(sim_mp3_volume() == 19 - 4 && sim_mp3_track() == 6);
+	mp3PlayTrack(catalog_track(0));                 // gain 0, same master level
+	sim_run_ms(50);
+	CHECK(sim_mp3_volume() == 19 && count_cmd('v') == v0 + burst + 2);
+	printf("volume: %u 'v' for a 20-detent spin, %u for 20 back-to-back levels\n", spun, burst);
+}
+
+// Runs until the Trigger starts a new track, returns ms since since_us
+static uint32_t until_start(uint64_t since_us)
+{
+	uint16_t plays = sim_mp3_plays();
+	for (uint16_t i = 0; i < 1000 && sim_mp3_plays() == plays; i++) sim_run_ms(1);
+	return (uint32_t)((sim_mp3_start_us() - since_us + 500) / 1000);
+}
+
+// Pick to audio at power-up, after a stop of an idle Trigger and a stop
+// plus a pick in one go; bytes to the Trigger only when they change its state
+static void latency(void)
+{
+	sim_mp3_track_ms(3000);
+	sim_run_ms(20);                                 // firmware up, Trigger still booting
+	uint64_t t0 = sim_now_us();
+	mp3PlayTrack(1);
+	uint32_t boot = until_start(t0);
+
+	sim_run_ms(3500);                               // track over, Trigger idle
+	mp3Stop();
+	sim_run_ms(1);
+	t0 = sim_now_us();
+	mp3PlayTrack(2);
+	uint32_t idle = until_start(t0);
+
+	sim_run_ms(500);
+	t0 = sim_now_us();
+	mp3Stop();                                      // admin stop with a pick right behind it
+	mp3PlayTrack(3);
+	uint32_t skip = until_start(t0);
+	printf("latency: pick to audio %u ms at boot, %u ms after an idle stop, %u ms stop+pick (log %s)\n",
+	       boot, idle, skip, sim_mp3_log());
+	CHECK(!strcmp(sim_mp3_log(), "QT1QQQT2T3"));    // no 'O' in either stop
+	CHECK(sim_mp3_track() == 3);
+
+	sim_run_ms(500);
+	mp3Stop();
+	sim_run_ms(20);                                 // sent by the next mp3Service()
+	CHECK(!sim_mp3_playing() && !strcmp(sim_mp3_log(), "QT1QQQT2T3O"));
+	mp3Stop();                                      // already stopped: nothing more
+	sim_run_ms(1200);
+	CHECK(!strcmp(sim_mp3_log(), "QT1QQQT2T3O"));
+}
+
+// MCU reset while the Trigger plays on: stopped once, not toggled blind
+static void mcu_reset(void)
+{
+	sim_mp3_track_ms(60000);
+	sim_mp3_playing_at_boot(5);
+	sim_run_ms(300);
+	CHECK(!strcmp(sim_mp3_log(), "QO") && !sim_mp3_playing());
+	CHECK(!mp3GetState().playing && shows_song(0));
+}
+
+// Loop statistics readable from the host; admin + PD5 held + knob pages through them
+static void instr(void)
+{
+	sim_run_ms(300);
+	instr_reset();
+	sim_run_ms(2000);
+	instrStats_t s;
+	instr_get(&s);
+	CHECK(s.loops >= 1900);                         // at least one pass per 1 ms tick
+	CHECK(s.loop_min > 0 && s.loop_min <= s.loop_avg8 / 8 && s.loop_avg8 / 8 <= s.loop_max);
+	CHECK(INSTR_US(s.loop_max) <= 1010);            // IDLE sleep never misses a tick
+	CHECK(s.busy_avg8 > 0 && s.busy_max >= s.busy_avg8 / 8);
+	CHECK(INSTR_US(s.busy_max) <= 100 && s.busy_avg8 * 10 < s.loop_avg8);   // no pass blocks, the loop mostly sleeps
+
+	sim_buttons(HAL_BTN_ADMIN);                     // not admin yet: PD5 + knob just browses
+	turn(+1, 200);
+	sim_buttons(0);
+	sim_run_ms(100);
+	CHECK(shows_song(1));
+	turn(-1, 200);
+
+	tap_card(admin_uid);
+	sim_run_ms(2600);
+	sim_buttons(HAL_BTN_ADMIN);
+	sim_run_ms(50);                                 // past the debounce
+	turn(+1, 100);
+	CHECK(shows(0, "Bsy") && shows(0, "Max") && shows(1, "Per") && shows(1, "Off"));
+	turn(+1, 100);
+	CHECK(shows(0, "Tck") && shows(0, "Enc") && shows(1, "Rx"));
+	turn(-1, 100);
+	CHECK(shows(0, "Gap") && shows(1, "Tsk"));
+	turn(+1, 100);
+	CHECK(shows(0, "In") && shows(1, "Frm"));       // boot report is the last page
+	sim_buttons(0);                                 // letting go is not a stop/shuffle press
+	sim_run_ms(5100);
+	CHECK(shows_song(0) && !strcmp(sim_mp3_log(), "Q"));
+	printf("instr: %u passes, loop min %u avg %u max %u us, busy avg %u max %u us\n", (unsigned)s.loops,
+	       INSTR_US(s.loop_min), INSTR_US(s.loop_avg8 / 8), INSTR_US(s.loop_max),
+	       INSTR_US(s.busy_avg8 / 8), INSTR_US(s.busy_max));
+}
+
+static void encoder(void)
+{
+	sim_run_ms(300);
+	turn(+1, 200);
+	CHECK(shows_song(1));
+	turn(-1, 200);
+	turn(-1, 200);
+	CHECK(shows_song(TOTAL_SONGS - 1));
+
+	turn(+1, 10);                                   // fast spin accelerates: 1 + 5 + 5
+	turn(+1, 10);
+	turn(+1, 200);
+	CHECK(shows_song((TOTAL_SONGS - 1 + 1 + 2 * ENC_FAST_STEP) % TOTAL_SONGS));
+
+	static const uint8_t cw_missed[3] = { 1, 2, 3 }, ccw_missed[3] = { 2, 1, 3 }, back[2] = { 1, 3 };
+	uint8_t at = (TOTAL_SONGS + 2 * ENC_FAST_STEP) % TOTAL_SONGS;
+	for (uint8_t i = 0; i < 3; i++) { sim_encoder_edge(cw_missed[i]); sim_run_ms(2); }
+	sim_run_ms(200);
+	CHECK(shows_song((at + 1) % TOTAL_SONGS));      // one edge lost, the detent still counts
+	for (uint8_t i = 0; i < 3; i++) { sim_encoder_edge(ccw_missed[i]); sim_run_ms(2); }
+	sim_run_ms(200);
+	CHECK(shows_song(at));
+	for (uint8_t i = 0; i < 2; i++) { sim_encoder_edge(back[i]); sim_run_ms(2); }
+	sim_run_ms(200);
+	CHECK(shows_song(at));                          // a quarter step and back is no detent
+}
+
+static void rfid_recovery(void)
+{
+	sim_run_ms(300);
+
+	sim_rfid_stuck(1);                              // reader stops clocking mid-read
+	sim_run_ms(200);
+	CHECK(sim_twi_recoveries() >= 2);
+	sim_rfid_stuck(0);
+
+	uint16_t r = sim_twi_recoveries();
+	sim_rfid_sda_low(5);                            // one read hangs with SDA held low
+	sim_run_ms(100);
+	CHECK(sim_twi_recoveries() == r + 1);
+
+	tap_card(user_uid);                             // reader works again afterwards
+	CHECK(shows(1, "C:1"));
+	CHECK(sim_twi_recoveries() == r + 1);
+}
+
+// Host time per main-loop pass with the UI busy (no pass/fail)
+static void bench(void)
+{
+	sim_mp3_track_ms(4000);
+	sim_run_ms(300);
+	tap_card(user_uid);
+	tap_card(admin_uid);
+	sim_run_ms(2600);
+
+	sim_bench_reset();
+	press(HAL_BTN_SELECT, 100);
+	for (uint8_t i = 0; i < 20; i++) turn(+1, 40);
+	sim_run_ms(5000);
+	printf("bench: %u loops, mean %llu ns, max %llu ns per pass\n",
+	       sim_bench_loops(), (unsigned long long)sim_bench_mean_ns(),
+	       (unsigned long long)sim_bench_max_ns());
+}
+
+static const struct { const char *name; void (*fn)(void); } scenarios[] = {
+	{ "boot",          boot },
+	{ "boot_profile",  boot_profile },
+	{ "credit_play",   credit_play },
+	{ "no_credit",     no_credit },
+	{ "admin_shuffle", admin_shuffle },
+	{ "shuffle_order", shuffle_order },
+	{ "queue",         queue },
+	{ "idle_power",    idle_power },
+	{ "persist",       persist },
+	{ "persist_wrap",  persist_wrap },
+	{ "cards",         cards },
+	{ "plays",         plays },
+	{ "instr",         instr },
+	{ "events",        events },
+	{ "buttons",       buttons },
+	{ "volume",        volume },
+	{ "latency",       latency },
+	{ "mcu_reset",     mcu_reset },
+	{ "encoder",       encoder },
+	{ "rfid_recovery", rfid_recovery },
+	{ "bench",         bench },
+};
+
+int main(int argc, char **argv)
+{
+	for (unsigned i = 0; argc > 1 && i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+	{
+		if (strcmp(argv[1], scenarios[i].name)) continue;
+		sim_boot();
+		scenarios[i].fn();
+		printf("PASS %s\n", scenarios[i].name);
+		return 0;
+	}
+	fprintf(stderr, "usage: %s <scenario>\n", argv[0]);
+	for (unsigned i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+		fprintf(stderr, "  %s\n", scenarios[i].name);
+	return 2;
+}
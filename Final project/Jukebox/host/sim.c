@@ -0,0 +1,570 @@
+// sim.c  -  virtual clock, interrupt delivery and fake jukebox peripherals
+//
+// Time only moves when the firmware waits: hal_idle() (end of a main-loop
+// pass, then IDLE sleep until an interrupt), _delay_us/_delay_ms, or the
+// bit-banged TWI recovery. Each virtual
+// microsecond the fakes are stepped and any raised interrupt whose enable
+// bit is set runs to completion, highest AVR vector priority first.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "hal.h"             // hal_host.h under HAL_HOST
+#include "sim.h"
+#include "jukebox_config.h"  // RFID_ADDR, MAX_UID_LEN
+#include <util/twi.h>        // TW_* status codes
+
+#define SIM_LOOP_US   10     // virtual time charged to the work of one main-loop pass
+#define SIM_UART_US   260    // one 8N1 byte at 38400 baud
+#define SIM_TRACKS    255    // tracks on the fake SD card
+#define SIM_MP3_BOOT_US 100000  // Trigger ignores the UART until its boot is done
+
+// Firmware vectors (weak so a build without one still links)
+void PCINT0_vect(void)       __attribute__((weak));
+void PCINT2_vect(void)       __attribute__((weak));
+void TIMER2_COMPA_vect(void) __attribute__((weak));
+void TIMER0_COMPA_vect(void) __attribute__((weak));
+void USART_RX_vect(void)     __attribute__((weak));
+void USART_UDRE_vect(void)   __attribute__((weak));
+void TWI_vect(void)          __attribute__((weak));
+
+int fw_main(void);           // firmware main(), renamed by the Makefile
+
+static uint64_t now;         // virtual microseconds since power-up
+static uint8_t  irq_on;      // SREG I bit
+static uint8_t  in_isr;
+static uint32_t isrs;        // interrupts delivered, ends an IDLE sleep
+static uint64_t slept;       // virtual us spent asleep in hal_idle()
+static uint8_t  amp;         // STA540 STBY level
+
+// ---------- Timers
+static uint8_t  t0_on, t0_flag;
+static uint64_t t0_next;
+static uint8_t  t2_on, t2_flag;
+static uint64_t t2_next;
+
+// ---------- UART + fake MP3 Trigger
+static uint8_t  udrie, tx_busy, tx_byte;
+static uint64_t tx_done;
+static uint8_t  rx_q[64], rx_head, rx_tail, rx_flag, rx_data;
+static uint64_t rx_due;
+
+static struct {
+	uint8_t  pending;        // 'T', 't' or 'v' waiting for its argument
+	uint8_t  loaded, playing, track, volume;
+	uint64_t end, left;      // track end time, remaining time while paused
+	uint64_t ended, gap;     // last natural track end, silence before the next start
+	uint64_t started;        // last track start
+	uint32_t track_us;
+	uint16_t plays;
+	char     log[4096];
+	uint16_t loglen;
+} mp3 = { .track_us = 3000000 };
+
+static uint8_t busy_irq, pc0_flag;
+
+// ---------- TWI + fake ID-12LA
+static struct {
+	uint8_t  en, ie, intf, sr, dr;
+	uint8_t  bus;            // 1 between START and STOP
+	uint8_t  phase;          // 0 = address next, 1 = writing, 2 = reading
+	uint8_t  ridx, busy, next_sr, byte_us;
+	uint64_t done;
+} twi;
+
+static char     card[MAX_UID_LEN];
+static uint8_t  card_on, reader_stuck, reader_hang, sda_hold, scl_high = 1;
+static uint16_t recoveries;
+static uint32_t polls;       // SLA+R addressed to the reader
+
+// ---------- HD44780
+static struct {
+	uint8_t  rs, data, e, four_bit, have_hi, hi, cg, addr;
+	uint8_t  wakeups;        // 8-bit function sets seen during the reset sequence
+	uint8_t  ddram[0x80], cgram[64];
+	uint64_t busy_until;
+	uint16_t violations;
+	uint32_t writes;         // DDRAM data writes
+} lcd;
+
+// ---------- EEPROM (1 KB, erased = 0xFF, 3.4 ms per byte write)
+#define SIM_EEPROM_US 3400
+static uint8_t  eeprom[1024];
+static uint16_t eeprom_wear[1024];
+static uint64_t eeprom_busy;
+
+// ---------- ADC noise
+static uint32_t noise = 1;
+
+// ---------- Knob and buttons
+static uint8_t enc_ab = 3, enc_irq, pc2_flag, buttons;
+
+// ---------- Coroutines and loop cost
+static ucontext_t sc_ctx, fw_ctx;
+static uint64_t   target;
+static uint64_t   last_out, cost_sum, cost_max;
+static uint32_t   loops;
+
+static uint64_t host_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// ---------- Fake MP3 Trigger
+static void log_str(const char *s)
+{
+	while (*s && mp3.loglen < sizeof(mp3.log) - 1) mp3.log[mp3.loglen++] = *s++;
+}
+
+static void reply(uint8_t c)
+{
+	uint8_t next = (rx_head + 1) & 63;
+	if (next == rx_tail) return;              // Trigger output lost
+	if (rx_head == rx_tail && !rx_flag) rx_due = now + SIM_UART_US;
+	rx_q[rx_head] = c;
+	rx_head = next;
+}
+
+static void busy_changed(void) { pc0_flag = 1; }
+
+static void mp3_start(uint8_t track)
+{
+	char b[8];
+	if (track < 1 || track > SIM_TRACKS) { reply('E'); return; }
+	if (mp3.loaded) reply('x');               // current track cancelled
+	mp3.loaded = mp3.playing = 1;
+	mp3.track  = track;
+	mp3.end    = now + mp3.track_us;
+	mp3.gap    = mp3.ended ? now - mp3.ended : 0;
+	mp3.started = now;
+	mp3.ended  = 0;
+	mp3.plays++;
+	snprintf(b, sizeof(b), "%u", track);
+	log_str(b);
+	busy_changed();
+}
+
+static void mp3_rx(uint8_t c)
+{
+	if (now < SIM_MP3_BOOT_US) { log_str("-"); return; }   // still booting, byte lost
+	if (mp3.pending)
+	{
+		uint8_t cmd = mp3.pending;
+		mp3.pending = 0;
+		if (cmd == 'v') { log_str("v"); mp3.volume = c; return; }
+		log_str(cmd == 'T' ? "T" : "t");
+		mp3_start(cmd == 'T' ? c - '0' : c);
+		return;
+	}
+	switch (c)
+	{
+	case 'T': case 't': case 'v':
+		mp3.pending = c;
+		break;
+	case 'O':                                 // start/stop toggle
+		log_str("O");
+		if (!mp3.loaded) break;
+		if (mp3.playing) { mp3.left = mp3.end - now; mp3.playing = 0; }
+		else             { mp3.end = now + mp3.left; mp3.playing = 1; }
+		busy_changed();
+		break;
+	case 'Q':
+		log_str("Q");
+		reply(mp3.playing ? 1 : 0);
+		break;
+	default:
+		log_str("?");
+		break;
+	}
+}
+
+// ---------- Fake TWI slave
+static void twi_after(uint8_t sr, uint8_t us)
+{
+	twi.busy    = 1;
+	twi.next_sr = sr;
+	twi.done    = now + us;
+}
+
+// ---------- HD44780 command/data execution
+static void lcd_exec(uint8_t rs, uint8_t b)
+{
+	uint16_t us = 37;
+	if (rs)
+	{
+		if (lcd.cg) lcd.cgram[lcd.addr & 0x3F] = b;
+		else        { lcd.ddram[lcd.addr & 0x7F] = b; lcd.writes++; }
+		lcd.addr++;
+		us = 41;
+	}
+	else if (b == 0x01)                       // clear display
+	{
+		memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+		lcd.addr = 0; lcd.cg = 0; us = 1520;
+	}
+	else if (b & 0x80) { lcd.addr = b & 0x7F; lcd.cg = 0; }
+	else if (b & 0x40) { lcd.addr = b & 0x3F; lcd.cg = 1; }
+	else if (b & 0x20)                        // function set; 4.1 ms, then 100 us on wake-up
+	{
+		if ((b & 0x10) && !lcd.four_bit && lcd.wakeups < 2) us = lcd.wakeups++ ? 100 : 4100;
+	}
+	else if ((b & 0xFE) == 0x02) { lcd.addr = 0; lcd.cg = 0; us = 1520; }  // home
+	lcd.busy_until = now + us;
+}
+
+static void lcd_latch(void)
+{
+	uint8_t n = lcd.data & 0x0F;
+	if (!lcd.have_hi && now < lcd.busy_until) lcd.violations++;
+
+	if (!lcd.four_bit)                        // 8-bit interface, only D7-D4 wired
+	{
+		lcd_exec(lcd.rs, n << 4);
+		if ((n << 4) == 0x20) lcd.four_bit = 1;
+		return;
+	}
+	if (!lcd.have_hi) { lcd.hi = n; lcd.have_hi = 1; return; }
+	lcd.have_hi = 0;
+	lcd_exec(lcd.rs, (lcd.hi << 4) | n);
+}
+
+// ---------- Clock and interrupts
+static void deliver(void)
+{
+	while (irq_on && !in_isr)
+	{
+		void (*v)(void);
+		if      (pc0_flag && busy_irq)  { pc0_flag = 0; v = PCINT0_vect; }
+		else if (pc2_flag && enc_irq)   { pc2_flag = 0; v = PCINT2_vect; }
+		else if (t2_flag && t2_on)      { t2_flag = 0;  v = TIMER2_COMPA_vect; }
+		else if (t0_flag)               { t0_flag = 0;  v = TIMER0_COMPA_vect; }
+		else if (rx_flag)               { v = USART_RX_vect; }     // cleared by hal_uart_get()
+		else if (udrie && !tx_busy)     { v = USART_UDRE_vect; }   // cleared by a write or UDRIE off
+		else if (twi.intf && twi.ie)    { v = TWI_vect; }          // cleared by writing TWINT
+		else break;
+		if (!v) break;
+
+		in_isr = 1; irq_on = 0;
+		isrs++;
+		v();
+		in_isr = 0; irq_on = 1;
+	}
+}
+
+static void step(void)
+{
+	now++;
+	if (t0_on && now >= t0_next) { t0_next += 1000; t0_flag = 1; }
+	if (t2_on && now >= t2_next) { t2_next += 1000; t2_flag = 1; }
+	if (tx_busy && now >= tx_done) { tx_busy = 0; mp3_rx(tx_byte); }
+	if (rx_head != rx_tail && !rx_flag && now >= rx_due)
+	{
+		rx_data = rx_q[rx_tail];
+		rx_tail = (rx_tail + 1) & 63;
+		rx_flag = 1;
+		rx_due  = now + SIM_UART_US;
+	}
+	if (twi.busy && now >= twi.done) { twi.busy = 0; twi.sr = twi.next_sr; twi.intf = 1; }
+	if (mp3.playing && now >= mp3.end)
+	{
+		mp3.playing = mp3.loaded = 0;
+		mp3.ended   = mp3.end;
+		reply('X');
+		busy_changed();
+	}
+}
+
+static void advance(uint64_t us)
+{
+	while (us--)
+	{
+		step();
+		deliver();
+	}
+}
+
+void sim_sei(void) { irq_on = 1; deliver(); }
+void sim_cli(void) { irq_on = 0; }
+
+uint8_t sim_irq_save(void)
+{
+	uint8_t s = irq_on;
+	irq_on = 0;
+	return s;
+}
+
+void sim_irq_restore(uint8_t *sreg)
+{
+	irq_on = *sreg;
+	deliver();
+}
+
+void sim_delay_us(double us)
+{
+	advance((uint64_t)(us + 0.999));
+}
+
+// ---------- HAL, host side
+void hal_wdt_off(void)  { }
+void hal_wdt_on(void)   { }
+void hal_wdt_kick(void) { advance(SIM_LOOP_US); }   // once per pass, after its work
+void hal_power_init(void) { }
+void hal_irq_on(void)  { sim_sei(); }
+
+void hal_idle(void)
+{
+	uint64_t t = host_ns();
+	if (last_out)
+	{
+		uint64_t d = t - last_out;
+		cost_sum += d;
+		if (d > cost_max) cost_max = d;
+		loops++;
+	}
+	uint32_t seen = isrs;                     // sleep_cpu(): wait for the next interrupt
+	while (isrs == seen && now < target) { advance(1); slept++; }
+	if (now >= target) swapcontext(&fw_ctx, &sc_ctx);
+	last_out = host_ns();
+}
+
+void hal_tick_init(uint8_t top) { (void)top; t0_on = 1; t0_next = now + 1000; }
+uint8_t hal_tick_count(void)
+{
+	uint64_t c = (now - (t0_next - 1000)) / 4;
+	return c > 249 ? 249 : (uint8_t)c;
+}
+uint8_t hal_tick_pending(void) { return t0_flag; }
+
+void     hal_stamp_init(void) { }
+uint16_t hal_stamp(void)      { return (uint16_t)(now * 2); }   // Timer1 at clk/8; ISRs take no virtual time
+
+void hal_gap_init(void)  { }
+void hal_gap_start(void) { t2_on = 1; t2_next = now + 1000; t2_flag = 0; }
+void hal_gap_stop(void)  { t2_on = 0; t2_flag = 0; }
+
+void hal_uart_init(uint16_t ubrr, uint8_t rx_irq) { (void)ubrr; (void)rx_irq; }
+uint8_t hal_uart_tx_ready(void)   { return !tx_busy; }
+uint8_t hal_uart_rx_ready(void)   { return rx_flag; }
+uint8_t hal_uart_tx_done(void)    { return !tx_busy; }
+void hal_uart_tx_irq_on(void)     { udrie = 1; deliver(); }
+void hal_uart_tx_irq_off(void)    { udrie = 0; }
+void hal_uart_put(uint8_t c)      { tx_byte = c; tx_busy = 1; tx_done = now + SIM_UART_US; }
+uint8_t hal_uart_get(void)        { rx_flag = 0; return rx_data; }
+
+void hal_busy_init(uint8_t irq) { busy_irq = irq; }
+uint8_t hal_busy_idle(void)     { return !mp3.playing; }
+
+void hal_lcd_init_pins(void)  { }
+void hal_lcd_data(uint8_t n)  { lcd.data = n & 0x0F; }
+void hal_lcd_rs(uint8_t on)   { lcd.rs = on; }
+void hal_lcd_e(uint8_t on)
+{
+	if (lcd.e && !on) lcd_latch();            // HD44780 latches on the falling edge
+	lcd.e = on;
+}
+
+void hal_twi_init(uint8_t twbr)
+{
+	twi.en = 1;
+	twi.byte_us = (9 * (16 + 2 * twbr) + 15) / 16;   // 9 SCL periods
+}
+
+void hal_twi_ctrl(uint8_t v)
+{
+	twi.en = (v >> TWEN) & 1;
+	twi.ie = (v >> TWIE) & 1;
+	if (!twi.en) { twi.intf = twi.busy = twi.bus = 0; return; }
+	if (!(v & (1 << TWINT))) return;
+	twi.intf = 0;                             // writing TWINT clears the flag
+
+	if (v & (1 << TWSTO))
+	{
+		twi.bus = 0;
+		if (!(v & (1 << TWSTA))) return;
+	}
+	if (v & (1 << TWSTA))
+	{
+		twi_after(twi.bus ? TW_REP_START : TW_START, 5);
+		twi.bus   = 1;
+		twi.phase = 0;
+		return;
+	}
+	if (reader_stuck || reader_hang) return;  // slave holds the bus, nothing completes
+
+	switch (twi.phase)
+	{
+	case 0:                                   // SLA+R/W in TWDR
+	{
+		uint8_t ok = (twi.dr >> 1) == RFID_ADDR;
+		if (twi.dr & 1)
+		{
+			polls += ok;
+			twi_after(ok ? TW_MR_SLA_ACK : TW_MR_SLA_NACK, twi.byte_us);
+			twi.phase = ok ? 2 : 0;
+			twi.ridx  = 0;
+		}
+		else
+		{
+			twi_after(ok ? TW_MT_SLA_ACK : TW_MT_SLA_NACK, twi.byte_us);
+			twi.phase = ok ? 1 : 0;
+		}
+		break;
+	}
+	case 1:
+		twi_after(TW_MT_DATA_ACK, twi.byte_us);
+		break;
+	case 2:
+		twi.dr = (card_on && twi.ridx < MAX_UID_LEN) ? (uint8_t)card[twi.ridx] : 0;
+		twi.ridx++;
+		twi_after((v & (1 << TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK, twi.byte_us);
+		break;
+	}
+}
+
+uint8_t hal_twi_status(void)  { return twi.sr; }
+void    hal_twi_put(uint8_t d) { twi.dr = d; }
+uint8_t hal_twi_get(void)      { return twi.dr; }
+
+void hal_twi_release(void)
+{
+	twi.en = twi.intf = twi.busy = twi.bus = 0;
+	recoveries++;
+	reader_hang = 0;                          // a glitched reader comes back after recovery
+}
+
+void hal_twi_scl(uint8_t high)
+{
+	if (high && !scl_high && sda_hold) sda_hold--;
+	scl_high = high;
+}
+void hal_twi_sda(uint8_t high) { (void)high; }
+uint8_t hal_twi_sda_high(void) { return !sda_hold; }
+
+// ADC noise: a fixed LCG, so each sim_noise_seed() value is one "power-up"
+void     hal_noise_init(void)   { }
+uint16_t hal_noise_sample(void) { noise = noise * 1103515245u + 12345u; return (noise >> 16) & 0x3FF; }
+void     hal_noise_off(void)    { }
+
+uint8_t sim_eeprom_ready(void) { return now >= eeprom_busy; }
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	while (!sim_eeprom_ready()) advance(1);   // reads wait for a write in progress
+	return eeprom[(uintptr_t)p & 1023];
+}
+void eeprom_write_byte(uint8_t *p, uint8_t v)
+{
+	while (!sim_eeprom_ready()) advance(1);
+	eeprom[(uintptr_t)p & 1023] = v;
+	eeprom_wear[(uintptr_t)p & 1023]++;
+	eeprom_busy = now + SIM_EEPROM_US;
+}
+
+void hal_amp_init(void)     { amp = 0; }
+void hal_amp(uint8_t on)    { amp = on; }
+
+void hal_encoder_init(void)     { enc_irq = 1; }
+uint8_t hal_encoder_ab(void)    { return enc_ab; }
+void hal_buttons_init(void)     { }
+uint8_t hal_buttons(void)       { return buttons; }
+
+// ---------- Scenario side
+static void fw_entry(void)
+{
+	fw_main();
+	fprintf(stderr, "sim: firmware main() returned\n");
+	exit(2);
+}
+
+void sim_boot(void)
+{
+	static char stack[1 << 18];
+	memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+	memset(eeprom, 0xFF, sizeof(eeprom));      // erased part
+	lcd.busy_until = 40000;                   // HD44780 needs 40 ms after power-up
+	getcontext(&fw_ctx);
+	fw_ctx.uc_stack.ss_sp   = stack;
+	fw_ctx.uc_stack.ss_size = sizeof(stack);
+	fw_ctx.uc_link = NULL;
+	makecontext(&fw_ctx, fw_entry, 0);
+}
+
+void sim_run_ms(uint32_t ms)
+{
+	target = now + (uint64_t)ms * 1000;
+	swapcontext(&sc_ctx, &fw_ctx);
+}
+
+uint64_t sim_now_us(void) { return now; }
+
+void sim_rfid_present(const char *uid)
+{
+	card_on = uid != NULL;
+	if (uid) memcpy(card, uid, MAX_UID_LEN);
+}
+
+void sim_rfid_stuck(uint8_t on) { reader_stuck = on; }
+
+void sim_rfid_sda_low(uint8_t clocks)
+{
+	reader_hang = 1;
+	sda_hold    = clocks;
+}
+
+uint16_t sim_twi_recoveries(void) { return recoveries; }
+uint32_t sim_rfid_polls(void)     { return polls; }
+
+void     sim_eeprom_poke(uint16_t addr, uint8_t v) { eeprom[addr & 1023] = v; }
+uint8_t  sim_eeprom_peek(uint16_t addr)            { return eeprom[addr & 1023]; }
+uint16_t sim_eeprom_wear(uint16_t addr)            { return eeprom_wear[addr & 1023]; }
+
+void sim_buttons(uint8_t mask) { buttons = mask; }
+void sim_noise_seed(uint32_t seed) { noise = seed; }
+
+void sim_encoder_edge(uint8_t ab)
+{
+	enc_ab   = ab & 3;
+	pc2_flag = 1;
+}
+
+void sim_lcd_line(uint8_t row, char *buf)
+{
+	const uint8_t *d = lcd.ddram + (row ? 0x40 : 0);
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		uint8_t c = d[i];
+		buf[i] = (c == 0) ? '*' : (c < 32 || c > 126) ? '?' : (char)c;
+	}
+	buf[16] = 0;
+}
+
+uint16_t sim_lcd_violations(void) { return lcd.violations; }
+uint32_t sim_lcd_writes(void)     { return lcd.writes; }
+uint8_t  sim_amp_on(void)         { return amp; }
+uint64_t sim_sleep_us(void)       { return slept; }
+
+void        sim_mp3_track_ms(uint32_t ms) { mp3.track_us = ms * 1000; }
+uint8_t     sim_mp3_playing(void) { return mp3.playing; }
+uint8_t     sim_mp3_track(void)   { return mp3.track; }
+uint16_t    sim_mp3_plays(void)   { return mp3.plays; }
+uint32_t    sim_mp3_gap_us(void)  { return mp3.gap; }
+uint8_t     sim_mp3_volume(void)  { return mp3.volume; }
+uint64_t    sim_mp3_start_us(void) { return mp3.started; }
+
+void sim_mp3_playing_at_boot(uint8_t track)
+{
+	mp3.loaded = mp3.playing = 1;
+	mp3.track  = track;
+	mp3.end    = now + mp3.track_us;
+}
+const char *sim_mp3_log(void)     { mp3.log[mp3.loglen] = 0; return mp3.log; }
+
+void sim_bench_reset(void) { loops = 0; cost_sum = cost_max = 0; }
+uint32_t sim_bench_loops(void)   { return loops; }
+uint64_t sim_bench_mean_ns(void) { return loops ? cost_sum / loops : 0; }
+uint64_t sim_bench_max_ns(void)  { return cost_max; }
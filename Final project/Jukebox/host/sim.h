@@ -0,0 +1,63 @@
+// sim.h  -  host simulator for the jukebox firmware
+//
+// The firmware's main() runs as a coroutine on a virtual microsecond clock.
+// A scenario drives the outside world (cards, buttons, knob) and lets the
+// firmware run with sim_run_ms(); every fake peripheral is deterministic.
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+// ---------- Used by the include/ shims
+void    sim_sei(void);
+void    sim_cli(void);
+uint8_t sim_irq_save(void);
+void    sim_irq_restore(uint8_t *sreg);
+void    sim_delay_us(double us);
+
+// ---------- Scenario side
+void     sim_boot(void);                    // set up the fakes, start the firmware
+void     sim_run_ms(uint32_t ms);           // let the firmware run for ms of virtual time
+uint64_t sim_now_us(void);
+
+void sim_rfid_present(const char *uid);     // card on the reader (NULL = removed)
+void sim_rfid_stuck(uint8_t on);            // reader stops answering mid-transfer
+void sim_rfid_sda_low(uint8_t clocks);      // reader holds SDA for this many SCL clocks
+uint16_t sim_twi_recoveries(void);          // bus recoveries seen by the fake reader
+uint32_t sim_rfid_polls(void);              // reads addressed to the reader
+
+// EEPROM starts erased at sim_boot(); poke before the first sim_run_ms() to preload
+void     sim_eeprom_poke(uint16_t addr, uint8_t v);   // no write time, no wear
+uint8_t  sim_eeprom_peek(uint16_t addr);
+uint16_t sim_eeprom_wear(uint16_t addr);            // erase/write cycles of one byte
+uint8_t  sim_eeprom_ready(void);                    // eeprom_is_ready() for the shim
+
+void sim_buttons(uint8_t mask);             // HAL_BTN_* pressed
+void sim_encoder_edge(uint8_t ab);          // new A/B level, raises PCINT2
+void sim_noise_seed(uint32_t seed);         // ADC noise at the next boot
+
+void        sim_lcd_line(uint8_t row, char *buf);   // 16 chars + NUL, CGRAM char 0 as '*'
+uint16_t    sim_lcd_violations(void);       // writes while the HD44780 was still busy
+uint32_t    sim_lcd_writes(void);           // characters written to DDRAM
+
+uint8_t     sim_amp_on(void);               // STA540 out of standby
+uint64_t    sim_sleep_us(void);             // time the MCU spent in IDLE sleep
+
+void        sim_mp3_track_ms(uint32_t ms);  // length of every track on the fake card
+uint8_t     sim_mp3_playing(void);
+uint8_t     sim_mp3_track(void);            // last track started (0 = none)
+uint16_t    sim_mp3_plays(void);            // tracks started since boot
+uint32_t    sim_mp3_gap_us(void);           // silence between a track's end and the next start
+uint8_t     sim_mp3_volume(void);           // last 'v' attenuation received (0 = power-up level)
+uint64_t    sim_mp3_start_us(void);         // when the last track started
+void        sim_mp3_playing_at_boot(uint8_t track); // only the MCU reset, the Trigger kept playing
+const char *sim_mp3_log(void);              // every command byte received, printable ('-' = lost during boot)
+
+// ---------- Loop cost (host time spent in one main-loop pass)
+void     sim_bench_reset(void);
+uint32_t sim_bench_loops(void);
+uint64_t sim_bench_mean_ns(void);
+uint64_t sim_bench_max_ns(void);
+
+#endif
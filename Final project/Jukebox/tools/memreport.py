@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""memreport.py - flash and SRAM used by each jukebox module.
+
+Reads the per-section sizes of every object file of a build (Atmel Studio
+puts them next to the .elf in Jukebox/Release or Jukebox/Debug):
+
+    memreport.py ../Jukebox/Release                 # all *.o, plus Jukebox.elf
+    memreport.py --size size ../host                # any toolchain's size(1)
+
+On the AVR both .data and .rodata are copied from flash into SRAM at
+startup, so a string literal costs twice; only .progmem (PROGMEM/PSTR)
+stays in flash alone. The "init" column shows that copied part, which is
+what moving strings to flash removes from SRAM.
+"""
+
+import glob
+import os
+import subprocess
+import sys
+
+RAM_BYTES = 2048
+FLASH_BYTES = 32768
+
+
+def sections(size_tool, path):
+    out = subprocess.run([size_tool, '-A', path], check=True,
+                         capture_output=True, text=True).stdout
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith('.') and parts[1].isdigit():
+            yield parts[0], int(parts[1])
+
+
+def classify(size_tool, path):
+    """(code, progmem, init, bss) bytes; init = .data + .rodata."""
+    code = progmem = init = bss = 0
+    for name, n in sections(size_tool, path):
+        if name.startswith('.progmem'):
+            progmem += n
+        elif name.startswith('.text'):
+            code += n
+        elif name.startswith(('.data', '.rodata')):
+            init += n
+        elif name.startswith(('.bss', '.noinit')):
+            bss += n
+    return code, progmem, init, bss
+
+
+def main():
+    args = sys.argv[1:]
+    size_tool = 'avr-size'
+    if args[:1] == ['--size']:
+        size_tool, args = args[1], args[2:]
+    if len(args) != 1:
+        sys.exit(__doc__)
+    build = args[0]
+
+    objs = sorted(glob.glob(os.path.join(build, '*.o')))
+    if not objs:
+        sys.exit('no object files in %s' % build)
+
+    fmt = '%-14s %7s %7s %7s %7s %8s %7s'
+    print(fmt % ('module', 'code', 'progmem', 'init', 'bss', 'flash', 'sram'))
+    total = [0, 0, 0, 0]
+    for o in objs:
+        c = classify(size_tool, o)
+        total = [a + b for a, b in zip(total, c)]
+        name = os.path.splitext(os.path.basename(o))[0]
+        print(fmt % (name, c[0], c[1], c[2], c[3], c[0] + c[1] + c[2], c[2] + c[3]))
+    print(fmt % ('modules', total[0], total[1], total[2], total[3],
+                 total[0] + total[1] + total[2], total[2] + total[3]))
+
+    elfs = glob.glob(os.path.join(build, '*.elf'))
+    for elf in elfs:                        # whole image, including libc
+        code, progmem, init, bss = classify(size_tool, elf)
+        flash, sram = code + progmem + init, init + bss
+        print('%s: flash %d/%d (%.1f%%), static sram %d/%d (%.1f%%)' % (
+            os.path.basename(elf), flash, FLASH_BYTES, 100.0 * flash / FLASH_BYTES,
+            sram, RAM_BYTES, 100.0 * sram / RAM_BYTES))
+
+
+if __name__ == '__main__':
+    main()
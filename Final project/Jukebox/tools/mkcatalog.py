@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""mkcatalog.py - builds Jukebox/catalog_data.h from the MP3 Trigger SD card.
+
+The Trigger plays files by their 3-digit prefix (001xxx.mp3 .. 255xxx.mp3),
+so the track list is taken either from the card itself or from a text list:
+
+    mkcatalog.py E:\\                       # scan the SD card root
+    mkcatalog.py tracks.txt                 # one "NNN|Title|Artist[|gain]" per line
+
+File names on the card are parsed as "NNN Title - Artist.mp3". Titles and
+artists are cut to the 16-character LCD width. The optional gain evens out
+loud and quiet recordings: Trigger volume steps added before the track
+plays (-128..127, negative = quieter); tracks read from a card get 0.
+
+Output format (all in flash):
+    catalog_index[]  uint16 offset of each entry in catalog_blob
+    catalog_blob[]   per entry: [track][gain][title]\\0[artist]\\0
+"""
+
+import os
+import re
+import sys
+
+MAX_ENTRIES = 255
+NAME_MAX = 16
+OUT = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                   "..", "Jukebox", "catalog_data.h")
+
+
+def from_card(root):
+    entries = []
+    for name in sorted(os.listdir(root)):
+        m = re.match(r"^(\d{3})\s*(.*?)\.mp3$", name, re.IGNORECASE)
+        if not m:
+            continue
+        track = int(m.group(1))
+        title, _, artist = m.group(2).partition(" - ")
+        entries.append((track, title.strip() or name, artist.strip(), 0))
+    return entries
+
+
+def from_list(path):
+    entries = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            parts = [p.strip() for p in line.split("|")]
+            parts += [""] * (4 - len(parts))
+            gain = int(parts[3] or 0)
+            if not -128 <= gain <= 127:
+                sys.exit("track %s: gain %d out of range" % (parts[0], gain))
+            entries.append((int(parts[0]), parts[1], parts[2], gain))
+    return entries
+
+
+def c_string(s):
+    s = s[:NAME_MAX].encode("ascii", "replace").decode("ascii")
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def emit(entries):
+    lines = [
+        "// catalog_data.h  -  generated by tools/mkcatalog.py, do not edit",
+        "// Included by jukebox_config.h for the count; catalog.c defines",
+        "// CATALOG_IMPL to get the flash tables.",
+        "",
+        "#ifndef CATALOG_DATA_H",
+        "#define CATALOG_DATA_H",
+        "",
+        "#define CATALOG_COUNT %d" % len(entries),
+        "",
+        "#endif",
+        "",
+        "#if defined(CATALOG_IMPL) && !defined(CATALOG_TABLES)",
+        "#define CATALOG_TABLES",
+        "",
+        "static const uint16_t catalog_index[CATALOG_COUNT] PROGMEM = {",
+    ]
+    offsets, blob, off = [], [], 0
+    for track, title, artist, gain in entries:
+        offsets.append(off)
+        blob.append('    "\\x%02X" "\\x%02X" %s "\\0" %s "\\0"' %
+                    (track, gain & 0xFF, c_string(title), c_string(artist)))
+        off += 2 + len(title[:NAME_MAX]) + 1 + len(artist[:NAME_MAX]) + 1
+    for i in range(0, len(offsets), 8):
+        lines.append("    " + ", ".join(str(o) for o in offsets[i:i + 8]) + ",")
+    lines += [
+        "};",
+        "",
+        "// [track][gain][title]\\0[artist]\\0 per entry, sorted by track",
+        "static const char catalog_blob[] PROGMEM =",
+    ]
+    lines += blob
+    lines[-1] += ";"
+    lines += ["", "#endif // CATALOG_IMPL", ""]
+    return "\n".join(lines)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    src = sys.argv[1]
+    entries = from_card(src) if os.path.isdir(src) else from_list(src)
+    entries = [e for e in entries if 1 <= e[0] <= 255]
+    if not entries:
+        sys.exit("no tracks found in %s" % src)
+    if len(entries) > MAX_ENTRIES:
+        sys.exit("%d tracks, the Trigger only addresses %d" % (len(entries), MAX_ENTRIES))
+    entries.sort(key=lambda e: e[0])
+    with open(OUT, "w", newline="\n") as f:
+        f.write(emit(entries))
+    print("%d tracks -> %s" % (len(entries), os.path.normpath(OUT)))
+
+
+if __name__ == "__main__":
+    main()
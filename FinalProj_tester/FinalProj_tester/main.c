@@ -8,14 +8,9 @@
 #include <string.h>
 #include <stdio.h>
 #include "mp3.h"
+#include "../../Final project/Jukebox/Jukebox/lcd.h" // shared LCD driver (pins in hal.h)
+#include "../../Final project/Jukebox/Jukebox/twi.h" // shared interrupt-driven TWI engine
 
-// ==== LCD CONFIG ====
-#define LCD_DATA_PORT PORTC
-#define LCD_DATA_DDR  DDRC
-#define LCD_CTRL_PORT PORTB
-#define LCD_CTRL_DDR  DDRB
-#define LCD_RS        PB0
-#define LCD_E         PB1
 #define OVERFLOWS_PER_SECOND 977
 
 // ==== RFID ====
@@ -60,69 +55,6 @@ uint8_t music_icon[8] = {
 	0b00000
 };
 
-// ==== LCD Functions ====
-void lcd_nibble(uint8_t nibble) {
-	LCD_DATA_PORT = (LCD_DATA_PORT & 0xF0) | (nibble & 0x0F);
-	LCD_CTRL_PORT |= (1 << LCD_E);
-	_delay_us(1);
-	LCD_CTRL_PORT &= ~(1 << LCD_E);
-	_delay_us(1);
-}
-
-void lcd_command(uint8_t cmd) {
-	LCD_CTRL_PORT &= ~(1 << LCD_RS);
-	lcd_nibble(cmd >> 4);
-	lcd_nibble(cmd & 0x0F);
-	_delay_us(40);
-}
-
-void lcd_data(uint8_t data) {
-	LCD_CTRL_PORT |= (1 << LCD_RS);
-	lcd_nibble(data >> 4);
-	lcd_nibble(data & 0x0F);
-	_delay_us(40);
-}
-
-void lcd_init(void) {
-	LCD_DATA_DDR |= 0x0F;
-	LCD_CTRL_DDR |= (1 << LCD_RS) | (1 << LCD_E);
-	_delay_ms(50);
-	lcd_nibble(0x03); _delay_ms(5);
-	lcd_nibble(0x03); _delay_us(150);
-	lcd_nibble(0x03); _delay_us(150);
-	lcd_nibble(0x02);
-	lcd_command(0x28);
-	lcd_command(0x0C);
-	lcd_command(0x06);
-	lcd_command(0x01);
-	_delay_ms(2);
-}
-
-void lcd_create_char(uint8_t location, uint8_t *charmap) {
-	location &= 0x07;
-	lcd_command(0x40 | (location << 3));
-	for (uint8_t i = 0; i < 8; i++) {
-		lcd_data(charmap[i]);
-	}
-}
-
-void lcd_clear(void) {
-	lcd_command(0x01);
-	_delay_ms(2);
-}
-
-void lcd_gotoxy(uint8_t x, uint8_t y) {
-	lcd_command(0x80 + (y ? 0x40 : 0x00) + x);
-}
-
-void lcd_putc(char c) {
-	lcd_data(c);
-}
-
-void lcd_puts(const char *s) {
-	while (*s) lcd_putc(*s++);
-}
-
 // ==== Timer/Interrupt ====
 void timer_init(void) {
 	TCCR0A = 0;
@@ -133,6 +65,7 @@ void timer_init(void) {
 
 ISR(TIMER0_OVF_vect) {
 	static uint16_t count = 0;
+	lcd_tick(); // one nibble of pending LCD changes per ~1 ms
 	count++;
 	if (count >= OVERFLOWS_PER_SECOND) {
 		last_scroll_time++;
@@ -200,47 +133,15 @@ uint8_t button_pressed2(void) {
 	}
 	return 0;
 }
-// ==== I2C ====
-void i2c_init(void) {
-	TWBR = 0x48;
-	TWCR = (1 << TWEN);
-}
-
-uint8_t i2c_start(uint8_t address) {
-	TWCR = (1 << TWSTA) | (1 << TWEN) | (1 << TWINT);
-	while (!(TWCR & (1 << TWINT)));
-	TWDR = address;
-	TWCR = (1 << TWEN) | (1 << TWINT);
-	while (!(TWCR & (1 << TWINT)));
-	return (TWSR & 0xF8);
-}
-
-void i2c_stop(void) {
-	TWCR = (1 << TWSTO) | (1 << TWEN) | (1 << TWINT);
-	while (TWCR & (1 << TWSTO));
-}
-
-uint8_t i2c_read_ack(void) {
-	TWCR = (1 << TWEN) | (1 << TWINT) | (1 << TWEA);
-	while (!(TWCR & (1 << TWINT)));
-	return TWDR;
-}
-
-uint8_t i2c_read_nack(void) {
-	TWCR = (1 << TWEN) | (1 << TWINT);
-	while (!(TWCR & (1 << TWINT)));
-	return TWDR;
-}
-
+// ==== RFID (shared TWI engine) ====
 uint8_t read_rfid_uid(char *uid_buf) {
-	if (i2c_start(RFID_ADDR << 1) != TW_MT_SLA_ACK) return 0;
-	i2c_stop();
-	if (i2c_start((RFID_ADDR << 1) | 1) != TW_MR_SLA_ACK) return 0;
-	for (uint8_t i = 0; i < MAX_UID_LEN; i++) {
-		uid_buf[i] = (i < MAX_UID_LEN - 1) ? i2c_read_ack() : i2c_read_nack();
+	twiXfer_t x = { .addr = RFID_ADDR, .rlen = MAX_UID_LEN, .rbuf = (uint8_t *)uid_buf, .timeout_ms = 10 };
+	twi_submit(&x);
+	while (x.status == TWI_PENDING) { // no 1 ms tick hook here, count the timeout while waiting
+		_delay_ms(1);
+		twi_tick();
 	}
-	i2c_stop();
-	return 1;
+	return x.status == TWI_OK;
 }
 
 // ==== Display ====
@@ -250,6 +151,7 @@ void show_admin_message(uint8_t enabled) {
 	lcd_puts("ADMIN");
 	lcd_gotoxy(1, 1);
 	lcd_puts(enabled ? " MODE ENABLED" : "MODE DISABLED");
+	lcd_flush();
 	_delay_ms(4000);
 }
 
@@ -275,6 +177,7 @@ void display_song(int index) {
 			lcd_gotoxy(15, 1);
 			lcd_putc(0); // music icon
 		}
+		lcd_flush();
 		return;
 	}
 
@@ -302,6 +205,7 @@ void display_song(int index) {
 			lcd_gotoxy(15, 1);
 			lcd_putc(0); // music icon
 		}
+		lcd_flush();
 		if (button_pressed()) {
 			if (credits > 0) {
 				if (credits != 255) credits--;
@@ -337,7 +241,7 @@ int main(void) {
 	// 3) Now do your normal init
 	lcd_init();
 	lcd_create_char(0, music_icon);
-	i2c_init();
+	twi_init(100000UL);
 	encoder_init();
 	button_init();
 	timer_init();
@@ -370,6 +274,7 @@ int main(void) {
 					lcd_puts(" Incorrect Card");
 					lcd_gotoxy(0, 1);
 					lcd_puts("   Admin Only");
+					lcd_flush();
 					_delay_ms(4000);
 					} else if (credits < 254) {
 					credits++;
@@ -434,6 +339,7 @@ int main(void) {
 					lcd_gotoxy(0, 1);
 					lcd_puts("Scan RFID to add");
 				}
+				lcd_flush();
 			}
 			if ((last_scroll_time - no_credit_time) >= 3) {
 				no_credit_flag = 0;
@@ -5,23 +5,17 @@
 #include <util/delay.h>
 #include "mp3.h"
 #include <stdlib.h>
-#define MP3_SERIAL_UBRR(b)  ((F_CPU/(16UL*(b)))-1)
+#include "../../Final project/Jukebox/Jukebox/uart.h" // shared polled USART0 driver
 
 
 static void usartSendByte(uint8_t c) {
-	while (!(UCSR0A & (1<<UDRE0)));
-	UDR0 = c;
-	while (!(UCSR0A & (1<<TXC0)));
-	UCSR0A |= (1<<TXC0);
+	uart_putc(c);
+	uart_flush();
 	_delay_ms(3);
 }
 
 void mp3Init(uint32_t baud) {
-	uint16_t ubrr = MP3_SERIAL_UBRR(baud);
-	UBRR0H = ubrr>>8;
-	UBRR0L = ubrr;
-	UCSR0B = (1<<TXEN0);
-	UCSR0C = (1<<UCSZ01)|(1<<UCSZ00);
+	uart_init(baud);
 	_delay_ms(10);
 	
 	usartSendByte('T');
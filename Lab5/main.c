@@ -4,57 +4,27 @@
 
 #define F_CPU 16000000UL //Defined that Arduino runs at 16MHz
 #include <avr/io.h> //Defines all of the AVR register(PORTS, UDR0, ADMUX,TWDR)
+#include <avr/interrupt.h> //sei() for the TWI interrupt
 #include <util/delay.h>  //uses delay_ms() for blocking
 #include <stdlib.h> //atoi(), atof(), lroundf()
 #include <stdio.h> //print funcs
 #include <string.h> //string manipulation
 #include <math.h> //rounding functions
+#include "../Final project/Jukebox/Jukebox/twi.h" //interrupt-driven TWI engine shared with the jukebox
+#include "../Final project/Jukebox/Jukebox/uart.h" //polled USART0 driver shared with the jukebox
 
-#define BAUD     9600UL //Buad rate (bits sent and received per second
-#define MYUBRR   ((F_CPU)/(16UL*BAUD) - 1) //UBRR = F_CPU/(16*Baud)-1
+#define BAUD     9600UL //Buad rate (bits sent and received per second, UBRR folded at compile time)
 
 // MAX517 fixed address (A0=A1=0) (0b10110000)
 #define MAX517_SLA_W 0x58     // 7-bit 0x58 with write bit
+#define MAX517_ADDR  (MAX517_SLA_W >> 1) // 7-bit address for the TWI engine
 
 // declarations
-void usartInit(uint16_t ubrr);
-void usartSendChar(char c);
-void usartSendString(const char *s);
-char usartReceiveChar(void);
 void adcInit(void);
 uint16_t adcRead(uint8_t ch);
 
 // I2C help
-void i2cInit(void);          // initialize TWI @100 kHz
-void i2cStart(void);         // send START
-void i2cWrite(uint8_t d);    // write byte, wait for ACK
-void i2cStop(void);          // send STOP
-
-// USART-----------------------------------------------------------
-void usartInit(uint16_t ubrr) //ubrr 16bit divisor
-{
-    UBRR0H = (uint8_t)(ubrr >> 8); //top 8 bits
-    UBRR0L = (uint8_t) ubrr; //bottom 8 bits, (shifted out to hardware)
-    UCSR0B = (1 << RXEN0) | (1 << TXEN0);   // set TX/RX, in control reg UCSr0B 
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00); // 8-N-1
-} //Once done oprates at 9600bps with 8bit frames
-
-void usartSendChar(char c)
-{   //waiting for USART(UCSR0A status reg) data reg to be empty
-    while (!(UCSR0A & (1 << UDRE0)));
-    UDR0 = c; //Once empty it writes char into data reg
-}   //UDR0 transmit data reg
-
-void usartSendString(const char *s) //takes C string, pointer to null-terminated array of chars
-{
-    while (*s) usartSendChar(*s++); //tests current char is non-zero
-}//Calls usartSendChar that blocks until the UART is ready then writes it out on PD1
-
-char usartReceiveChar(void)
-{ //RXC0 (receive complete) becomes 1 when the Uart hardware has received the char into UDR0
-    while (!(UCSR0A & (1 << RXC0))); //runs until char is on RXD(PD0)
-    return UDR0;//read and return UDR0, and clear the RXC0 flag, prepares for next byte
-}
+uint8_t dacWrite(uint8_t cmdByte, uint8_t code); // MAX517 command + code, returns TWI_* status
 
 // ADC----------------------------------------------------------
 
@@ -81,41 +51,18 @@ uint16_t adcRead(uint8_t ch)
 }
 
 // I2C-----------------------------------------------------------------
-void i2cInit(void)
-{
-    TWSR = 0; //sets a prescaler of 1 [TWPS = 00 = 1]
-    TWBR = ((F_CPU / 100000UL) - 16) / 2; //sets the bit rate 
-	//TWBR = (16MHz/100kHz -16)/2 = 72 (Determines SCL speed)
-	
-    TWCR = (1 << TWEN);//sets enable on TWI (I2C) hardware
-	
-}// when ran, the Two wire inerface pins generate bus signals at ~100kHz
-
-void i2cStart(void)
-{//sending start conditions to bus
-    TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
-	//In order; Clears interrupt flag, Transmits the start condition, Makes sure TWI is enabled
-    while (!(TWCR & (1 << TWINT)));
-	//waits for the srart to complete
-}
-
-void i2cWrite(uint8_t d)
+uint8_t dacWrite(uint8_t cmdByte, uint8_t code)
 {
-    TWDR = d;//Loads the data/address byte into TWI data reg
-	//put 'd' onto SDA to shift out
-	
-    TWCR = (1 << TWINT) | (1 << TWEN);//Clear TWINT + maek sure TWEN so hardware begins transmitting
-	// In order; Clears interrupt flag to start, Keeps TWI enabled
-	
-    while (!(TWCR & (1 << TWINT)));//Blocks all bytes sent until the ACK/NACK is received 
-}
-
-void i2cStop(void)
-{//issues stop condition to bus
-    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
-	//TWSTO = 1 -SDA goes high while SCA is high
-	//TWINT = 1 -clears pending interrupt
-	//Twen = 1 -keeps hardware enabled
+    uint8_t   buf[2] = { cmdByte, code }; //command byte, then the 8-bit output code
+    twiXfer_t x = { .addr = MAX517_ADDR, .wlen = 2, .wbuf = buf, .timeout_ms = 5 };
+
+    twi_submit(&x); //START, SLA+W, 2 bytes, STOP all run from TWI_vect
+    while (x.status == TWI_PENDING) //no timer tick in this lab, so count the timeout here
+    {
+        _delay_ms(1);
+        twi_tick();
+    }
+    return x.status; //TWI_OK once the DAC ACKed both bytes
 }
 
 // helpers
@@ -127,15 +74,16 @@ static void delaySeconds(uint8_t sec)
 // Main----------------------------------------------------------------------
 int main(void)
 {
-	//sets up the UART at the baud rate specified by MYUBRR
-	usartInit(MYUBRR);
+	//sets up the UART at 9600 8-N-1
+	uart_init(BAUD);
 	//Configures ADC to take analog voltage values
 	adcInit();
 	//Set up the i2c connection
-	i2cInit();
+	twi_init(100000UL);
+	sei(); //TWI engine is interrupt driven
 
 	//Sends these strings on startup as the instructions
-	usartSendString(
+	uart_puts(
 	"Ready.\r\n"
 	"  G            - get single voltage\r\n"
 	"  M,n,dt       - n readings, dt seconds apart\r\n"
@@ -151,7 +99,7 @@ int main(void)
 	while (1)
 	{
 		//This will wait until a new command is entered
-		char c = usartReceiveChar();
+		char c = uart_getc();
 
 		//If the user pressed enter
 		if (c == '\r' || c == '\n')
@@ -178,7 +126,7 @@ int main(void)
 				char     out[32];
 				snprintf(out, sizeof out, "v=%s V\r\n", vStr);
 				//Send result back to UART
-				usartSendString(out);
+				uart_puts(out);
 				continue;
 			}
 
@@ -200,14 +148,14 @@ int main(void)
 				//Check if the values are in the given ranges
 				if (n < 2 || n > 20 || dt < 1 || dt > 10)
 				{
-					usartSendString("ERROR: range n=2-20, dt=1-10\r\n");
+					uart_puts("ERROR: range n=2-20, dt=1-10\r\n");
 					continue;
 				}
 
 				//Echo back the command
 				char header[24];
 				snprintf(header, sizeof header, "M,%u,%u\r\n", n, dt);
-				usartSendString(header);
+				uart_puts(header);
 
 				//Loop for n readings
 				for (uint8_t i = 0; i < n; ++i)
@@ -221,7 +169,7 @@ int main(void)
 					//Print the time since the loop started in s and what the voltage is currently
 					snprintf(line, sizeof line,
 					"t=%u s, v=%s V\r\n", (unsigned)(i * dt), vStr);
-					usartSendString(line);
+					uart_puts(line);
 
 					//If n does not = -1 do a delay for dt seconds
 					if (i != n - 1) delaySeconds(dt);
@@ -243,7 +191,7 @@ int main(void)
 
                 if ((chan > 1) || volts < 0.0f || volts > 5.0f) //If statement to catch if user screwed up input
                 {
-                    usartSendString("ERROR: S,c,v  c=0|1  v=0-5\r\n");
+                    uart_puts("ERROR: S,c,v  c=0|1  v=0-5\r\n");
                     continue;
                 }
 
@@ -251,15 +199,13 @@ int main(void)
 				//Scales to 8-bit digital value (518 needs int from 0-255)
                 uint8_t cmdByte = chan & 0x01;  // PowerDown=0 Reset=0 A0= which DAC channel we're loading
 				
-				//calling functions  to use 
-                i2cStart();//Tells bus I'm the master
-                i2cWrite(MAX517_SLA_W); //Shifts out DAC 7bit addr and the write bit
-				//Max518 sees addr and pulls SDA on low on the 9th clock as ACK
-				
-                i2cWrite(cmdByte); //Sends the command byte that tells DAC which channel to use
-                i2cWrite(code); //Sends 8-bit scaled voltage code. When received, DAC updates
-                i2cStop();//Generates stop condition, triggers MAX to transfer input latch onto
-				//output amp, fianlly physically changes the voltage on outputs
+				//START, address, command byte, code, STOP. The STOP makes the MAX transfer
+				//its input latch onto the output amp, which changes the voltage on the outputs
+                if (dacWrite(cmdByte, code) != TWI_OK)
+                {
+                    uart_puts("ERROR: DAC not responding\r\n");
+                    continue;
+                }
 
                 // build response with dtostrf (printf %f not supported)
                 char  vStr2[8];
@@ -268,11 +214,11 @@ int main(void)
                 snprintf(resp, sizeof resp, //takes Channel #, voltage string and, code into resp
                          "DAC channel %u set to %s V (%u)\r\n",
                          chan, vStr2, code);
-                usartSendString(resp);//sends info back over serial link to see:
+                uart_puts(resp);//sends info back over serial link to see:
                 continue;
             }
 
-            usartSendString("ERROR: unknown command\r\n"); //error message for unknown command
+            uart_puts("ERROR: unknown command\r\n"); //error message for unknown command
         }
         else if (idx < sizeof cmdBuf - 1) //checks if incoming char 'c' was not a line terminator
         { //stuff in else statement makes sure that we never go to the end of the array, but leaves room for \0 terminator